@@ -89,12 +89,11 @@ int main(void)
 
             usb_flush_input_buffer();
 
-            if(mf_send_time.duration <= 0){ 
+            if(mf_send_time.period == 0){ 
                 usb_send_msg("cBf", command, &data, sizeof(data)); // send response
                 mf_send_time.active = false;
-            }else if(SecondsSince(&mf_send_time.last_trigger_time) >= mf_send_time.duration){
+            }else{
                     usb_send_msg("cBf", command, &data, sizeof(data)); // send response
-                    mf_send_time.last_trigger_time = GetTime();
                 }
             // }else{
             //     mf_send_time.last_trigger_time = GetTime();
@@ -106,27 +105,26 @@ int main(void)
         }
 
         // [State-machine flag] Time to complete loop
-        if(MSG_FLAG_Execute(&mf_loop_timer)){
+        if(mf_loop_timer.active){
             static Time_t loopTimeStart;    // struct to store loop time (static so it doesn't get deleted after this inner loop ends)
             
             if(firstLoop){
                 loopTimeStart = GetTime();   // fill loopTime struct
-            }else{
+            }else if(MSG_FLAG_Execute(&mf_loop_timer)){
                 command = mf_loop_timer.command;
                 data.B = mf_loop_timer.subcommand;
                 data.f = SecondsSince(&loopTimeStart); 
 
                 usb_flush_input_buffer();
 
-                if(mf_loop_timer.duration <= 0){ 
+                if(mf_loop_timer.period == 0){ 
                     usb_send_msg("cBf", command, &data, sizeof(data)); // send response
                     mf_loop_timer.active = false;
-                }else if(SecondsSince(&mf_loop_timer.last_trigger_time) >= mf_loop_timer.duration){
+                }else{
                         usb_send_msg("cBf", command, &data, sizeof(data)); // send response
-                        mf_loop_timer.last_trigger_time = GetTime();
                     }
 
-                /*if(mf_loop_timer.duration <= 0){
+                /*if(mf_loop_timer.period == 0){
                     usb_send_msg("cBf", command, &data, sizeof(data)); // send response
                     mf_loop_timer.active = false;
                 }*/
@@ -157,7 +155,7 @@ int main(void)
             USB_Upkeep_Task(); // wait for send (won't send without this)
             data.f = SecondsSince(&floatSendStart);   // get time since send
 
-            if(mf_time_float_send.duration <= 0){
+            if(mf_time_float_send.period == 0){
                 usb_send_msg("cBf", command, &data, sizeof(data)); // send response
                 mf_time_float_send.active = false;
             }else{
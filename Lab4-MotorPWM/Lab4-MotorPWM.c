@@ -24,6 +24,10 @@
     SOFTWARE.
 */
 
+// Filters this lab binds to the c_lib filter pool (see Filter.h); must come before the c_lib includes
+#define FILTER_POOL_SLOT_LIST(X)        \
+    X(FILTER_SLOT_VOLTAGE,       4, 1)
+
 #include "../c_lib/SerialIO.h"
 #include "../c_lib/Timing.h"
 #include "../c_lib/MEGN540_MessageHandeling.h"
@@ -32,6 +36,9 @@
 #include "../c_lib/Filter.h"
 #include "../c_lib/MotorPWM.h"
 
+// Storage for the filters listed in FILTER_POOL_SLOT_LIST
+FILTER_POOL_DEFINE();
+
 void Debug()
 {
     char debug[5] = "debug";
@@ -92,7 +99,7 @@ int main(void)
     float numerator_coeffs[5]   = {0.00178260999192539,0.00713043996770157,0.0106956599515524,0.00713043996770157,0.00178260999192539}; // Matlab B values
     float denominator_coeffs[5] = {1,-2.77368231754887,3.01903869942386,-1.50476505142532,0.287930429421141}; // Matlab A values
     // Create instance of filter stucture for battery voltage
-    Filter_Data_t voltage_Filter;
+    Filter_Data_t voltage_Filter = FILTER_POOL_BIND(FILTER_SLOT_VOLTAGE);
     // Initalize filter (might be good to add an if to the Initalize() call to reinitalize this too, if needed)
     Filter_Init(&voltage_Filter, numerator_coeffs, denominator_coeffs, order);
     // Initialize variables for saving unfltered & filtered voltage
@@ -126,34 +133,32 @@ int main(void)
 
             usb_flush_input_buffer();
 
-            if(mf_send_time.duration <= 0){ 
+            if(mf_send_time.period == 0){ 
                 usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
                 mf_send_time.active = false;
-            }else if(SecondsSince(&mf_send_time.last_trigger_time) >= mf_send_time.duration){
+            }else{
                     usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
-                    mf_send_time.last_trigger_time = GetTime();
                 }
         }
 
         // [State-machine flag] Time to complete loop
-        if(MSG_FLAG_Execute(&mf_loop_timer)){
+        if(mf_loop_timer.active){
             static Time_t loopTimeStart;    // struct to store loop time (static so it doesn't get deleted after this inner loop ends)
             
             if(firstLoop){
                 loopTimeStart = GetTime();   // fill loopTime struct
-            }else{
+            }else if(MSG_FLAG_Execute(&mf_loop_timer)){
                 command = mf_loop_timer.command;
                 timeData.B = mf_loop_timer.subcommand;
                 timeData.f = SecondsSince(&loopTimeStart); 
 
                 usb_flush_input_buffer();
 
-                if(mf_loop_timer.duration <= 0){ 
+                if(mf_loop_timer.period == 0){ 
                     usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
                     mf_loop_timer.active = false;
-                }else if(SecondsSince(&mf_loop_timer.last_trigger_time) >= mf_loop_timer.duration){
+                }else{
                         usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
-                        mf_loop_timer.last_trigger_time = GetTime();
                     }
             }
             firstLoop = !firstLoop; // flip boolean since it is only checking the time of one loop
@@ -175,7 +180,7 @@ int main(void)
             USB_Upkeep_Task(); // wait for send (won't send without this)
             data.f = SecondsSince(&floatSendStart);   // get time since send
 
-            if(mf_time_float_send.duration <= 0){
+            if(mf_time_float_send.period == 0){
                 usb_send_msg("cBf", command, &data, sizeof(data)); // send response
                 mf_time_float_send.active = false;
             }
@@ -190,12 +195,11 @@ int main(void)
 
             usb_flush_input_buffer();
 
-            if(mf_send_encoder.duration <= 0){
+            if(mf_send_encoder.period == 0){
                 usb_send_msg("cff", 'e', &encoderData, sizeof(encoderData)); // send response
                 mf_send_encoder.active = false;
-            }else if(SecondsSince(&mf_send_encoder.last_trigger_time) >= mf_send_encoder.duration){
+            }else{
                 usb_send_msg("cff", 'E', &encoderData, sizeof(encoderData)); // send response
-                mf_send_encoder.last_trigger_time = GetTime();
             }
         }
 
@@ -235,12 +239,11 @@ int main(void)
         
         // [State-machine flag] Send battery voltage
         if(MSG_FLAG_Execute(&mf_send_voltage)){
-            if(mf_send_voltage.duration <= 0){
+            if(mf_send_voltage.period == 0){
                 usb_send_msg("cf", 'b', &filtered_voltage, sizeof(filtered_voltage));
                 mf_send_voltage.active = false;
-            }else if(SecondsSince(&mf_send_voltage.last_trigger_time) >= mf_send_voltage.duration){
+            }else{
                 usb_send_msg("cf", 'B', &filtered_voltage, sizeof(filtered_voltage));
-                mf_send_voltage.last_trigger_time = GetTime();
             }
         }
 
@@ -271,7 +274,7 @@ int main(void)
                 mf_set_PWM.active = false;
             }
             
-            else if(PWM_data.timed && SecondsSince(&mf_set_PWM.last_trigger_time) >= mf_set_PWM.duration){
+            else if(PWM_data.timed && TicksSince(&mf_set_PWM.last_trigger_time) >= (uint32_t)mf_set_PWM.time_limit){
                 mf_set_PWM.active = false;
                 mf_stop_PWM.active = true;
             }        
@@ -293,7 +296,7 @@ int main(void)
             }
             
 
-            if(mf_send_sys_info.duration <= 0){
+            if(mf_send_sys_info.period == 0){
                 systemData.time      = SecondsSince(&systemDataTime.startTime);
                 systemData.PWM_L     = Get_Motor_PWM_Left();
                 systemData.PWM_R     = Get_Motor_PWM_Right();
@@ -306,8 +309,7 @@ int main(void)
 
                 firstLoopSysData = !firstLoopSysData;
                 
-            }else if(SecondsSince(&systemDataTime.last_trigger_time) >= mf_send_sys_info.duration){
-                systemDataTime.last_trigger_time = GetTime();
+            }else{
 
                 systemData.time      = SecondsSince(&systemDataTime.startTime);
                 systemData.PWM_L     = Get_Motor_PWM_Left();
@@ -28,6 +28,11 @@
 
 */
 
+// Filters this lab binds to the c_lib filter pool (see Filter.h); must come before the c_lib includes
+#define FILTER_POOL_SLOT_LIST(X)        \
+    X(FILTER_SLOT_CONTROL_LEFT,  1, 1)  \
+    X(FILTER_SLOT_CONTROL_RIGHT, 1, 1)
+
 #include "../c_lib/SerialIO.h"
 #include <stdlib.h>
 #include "../c_lib/MEGN540_MessageHandeling.h"
@@ -37,6 +42,20 @@
 #include "../c_lib/Filter.h"
 #include "../c_lib/Battery_Monitor.h"
 #include "../c_lib/Controller.h"
+#include "../c_lib/Timer_Wheel.h"
+#include "../c_lib/Control_Tick.h"
+#include "../c_lib/Loop_Stats.h"
+#include "../c_lib/Profile.h"
+
+// Storage for the filters listed in FILTER_POOL_SLOT_LIST
+FILTER_POOL_DEFINE();
+
+// Software timers (Timer_Wheel ids)
+#define BATT_WARN_TIMER 0   // battery/power warnings are sent at most this often
+#define BATT_WARN_PERIOD_MS 3000
+
+// Wheel controllers are stepped from the Timer3 control tick at this period
+#define CONTROL_PERIOD_US 5000
 
 /**
  * Function to re/initialize states
@@ -50,7 +69,122 @@ void Initialize()
     Encoders_Init();         // Initalize encoders
     Battery_Monitor_Init();  // Initalize battery monitor
     Motor_PWM_Init(400);     // Initialize motors at TOP PWM of 400
+    Control_Tick_Init(CONTROL_PERIOD_US); // Initialize the control tick (stopped)
+    Profile_Init();          // Clear the section profiler (shares Timer3 with the control tick)
     usb_flush_input_buffer();// Flush buffer
+
+    Timer_Wheel_Start(BATT_WARN_TIMER, BATT_WARN_PERIOD_MS, BATT_WARN_PERIOD_MS, NULL);
+}
+
+// Latest filtered battery voltage, reported by Send_Voltage_Task
+static float filtered_voltage = 0;
+
+/**
+ * Task Send_Time_Task reports the current time ('t' subcommand 0, or 'T' subcommand 1 every period).
+ */
+static void Send_Time_Task(MSG_FLAG_t* p_flag)
+{
+    struct __attribute__((__packed__)) { uint8_t B; float f; } timeData;
+    timeData.B = p_flag->subcommand;
+    timeData.f = GetTimeSec();
+
+    usb_send_msg("cBf", p_flag->command, &timeData, sizeof(timeData)); // send response
+
+    if(p_flag->period == 0) p_flag->active = false;
+}
+
+/**
+ * Task Send_Encoder_Task reports the encoder angles once ('e') or every period ('E').
+ */
+static void Send_Encoder_Task(MSG_FLAG_t* p_flag)
+{
+    // Build a meaningful structure to put encoder radians in into.
+    struct __attribute__((packed)) { float L_Rad; float R_Rad; } encoderData;
+    encoderData.L_Rad = Rad_Left();
+    encoderData.R_Rad = Rad_Right();
+
+    if(p_flag->period == 0){
+        usb_send_msg("cff", 'e', &encoderData, sizeof(encoderData)); // send response
+        p_flag->active = false;
+    }else{
+        usb_send_msg("cff", 'E', &encoderData, sizeof(encoderData)); // send response
+    }
+}
+
+/**
+ * Task Send_Voltage_Task reports the filtered battery voltage once ('b') or every period ('B').
+ */
+static void Send_Voltage_Task(MSG_FLAG_t* p_flag)
+{
+    if(p_flag->period == 0){
+        usb_send_msg("cf", 'b', &filtered_voltage, sizeof(filtered_voltage));
+        p_flag->active = false;
+    }else{
+        usb_send_msg("cf", 'B', &filtered_voltage, sizeof(filtered_voltage));
+    }
+}
+
+// Left and right track controllers, stepped by the control tick ISR (Distance_Step / Velocity_Step)
+static Controller_t control_Filter_L = { .controller = FILTER_POOL_BIND(FILTER_SLOT_CONTROL_LEFT) };
+static Controller_t control_Filter_R = { .controller = FILTER_POOL_BIND(FILTER_SLOT_CONTROL_RIGHT) };
+// Encoder angles at the start of the current motion
+static float startRad_L;
+static float startRad_R;
+// Commanded move, copied when the motion starts so the ISR never reads a half-written command
+static MOVE_INFO_t control_target;
+// [m] (aka 35 mm / 2)
+static const float trackWheelRadius = 0.035/2;
+
+/**
+ * Control step for distance mode, run every control tick: turn in place to the commanded angle, then drive the
+ * commanded distance. Returns false once both are reached.
+ */
+static bool Distance_Step(const Control_Tick_Sample_t* p_sample, Control_Tick_Output_t* p_output)
+{
+    // Linear
+    float distanceTraveled_L = (p_sample->rad_left - startRad_L) * trackWheelRadius;
+    float distanceTraveled_R = (p_sample->rad_right - startRad_R) * trackWheelRadius;
+    float distanceTraveled_Total = (distanceTraveled_L + distanceTraveled_R)/2;
+    // Angular
+    float angleTraveled_L = distanceTraveled_L / trackWheelRadius;
+    float angleTraveled_R = distanceTraveled_R / trackWheelRadius;
+    float angleTraveled_Total = (angleTraveled_R - angleTraveled_L)/2;
+
+    // Move distance
+    if(angleTraveled_Total < control_target.angular && control_target.angular != 0){
+        control_Filter_L.target_pos = -control_target.angular;
+        control_Filter_R.target_pos = control_target.angular;
+
+        p_output->left  = Controller_Update(&control_Filter_L, angleTraveled_L, p_sample->dt);
+        p_output->right = Controller_Update(&control_Filter_R, angleTraveled_R, p_sample->dt);
+    }else if(distanceTraveled_Total < control_target.linear){
+        control_Filter_L.target_pos = control_target.linear;
+        control_Filter_R.target_pos = control_target.linear;
+
+        p_output->left  = Controller_Update(&control_Filter_L, distanceTraveled_L, p_sample->dt);
+        p_output->right = Controller_Update(&control_Filter_R, distanceTraveled_R, p_sample->dt);
+    }else{
+        return false; // arrived
+    }
+
+    return true;
+}
+
+/**
+ * Control step for velocity mode, run every control tick until the time limit stops it.
+ */
+static bool Velocity_Step(const Control_Tick_Sample_t* p_sample, Control_Tick_Output_t* p_output)
+{
+    float distanceTraveled_L = (p_sample->rad_left - startRad_L) * trackWheelRadius;
+    float distanceTraveled_R = (p_sample->rad_right - startRad_R) * trackWheelRadius;
+
+    distanceTraveled_L = distanceTraveled_L / p_sample->dt;
+    distanceTraveled_R = distanceTraveled_R / p_sample->dt;
+
+    p_output->left  = Controller_Update(&control_Filter_L, distanceTraveled_L, p_sample->dt);
+    p_output->right = Controller_Update(&control_Filter_R, distanceTraveled_R, p_sample->dt);
+
+    return true;
 }
 
 /** Main program entry point. This routine configures the hardware required by the application, then
@@ -60,12 +194,14 @@ int main(void)
 {
     Initialize();
 
+    MSG_Scheduler_Add(&mf_send_time,    Send_Time_Task);
+    MSG_Scheduler_Add(&mf_send_encoder, Send_Encoder_Task);
+    MSG_Scheduler_Add(&mf_send_voltage, Send_Voltage_Task);
+
     // Tracking variable for timers
     bool firstLoop  = true;
-    bool firstLoopV = true;
     bool firstLoopSysData = true;
     bool firstLoopDist = true;
-    bool secondLoopDist = true;
     bool firstLoopVeloc = true;
 
     //////////////////////////////
@@ -84,122 +220,114 @@ int main(void)
     // Power off message
     struct __attribute__((__packed__)) { char let[9]; } pwr_off_msg = {.let = {'P','O','W','E','R',' ','O','F','F'}};
     // Battery check interval (every X seconds)
-    float batUpdateInterval = 0.002;
+    uint32_t batUpdateTicks = 2; // [ms]
     // Time structure for getting voltage and filtering at intervals
     Time_t batVoltageFilter = GetTime();
-    // Time structure for sending battery/power warnings every X seconds
-    Time_t battPwrWarnTimer = GetTime();
-    // Send warning every X seconds rather than constantly
-    float battPwrWarnInterval = 3;
     // Minimum battery voltage (min NiMh batt voltage * num batteries)
     float minBatVoltage = 1.1875 * 4;
     // Lower voltage threshold to warn if power is off
     float offBattVoltage = 3.0;
-    // Order & coefficients for Butterworth filter from homework (cut off = 3750Hz (15), sampling = 125000Hz (200), order 4)
-    int   order = 4;
-    float numerator_coeffs[5]   = {0.00178260999192539,0.00713043996770157,0.0106956599515524,0.00713043996770157,0.00178260999192539}; // Matlab B values
-    float denominator_coeffs[5] = {1,-2.77368231754887,3.01903869942386,-1.50476505142532,0.287930429421141}; // Matlab A values
+    // 4th order Butterworth with the homework filter's 37.5 Hz cut off, re-derived for the battery's ADC_Scan rate:
+    // ADC_SCAN_BATTERY oversamples by 1 bit, one 11 bit result every 4 ms (250 Hz), so Wn = 37.5/125 = 0.3
+    // (Matlab butter(4,0.3); the homework's Wn = 0.15 was for a 2 ms sample period). Factored into second order
+    // sections { B0 B1 B2 A0 A1 A2 }; the product of the sections is the Matlab B/A:
+    //   B = {0.0185630106268972,0.0742520425075887,0.111378063761383,0.0742520425075887,0.0185630106268972}
+    //   A = {1,-1.57039885122817,1.27561332498328,-0.484403368335086,0.0761970646103324}
+    // Each section has unity DC gain.
+    uint8_t sections = 2;
+    const float voltage_sos[2][6] = {{0.117948572160398,0.235897144320797,0.117948572160398,1,-0.672740911191527,0.144535199833121},
+                                     {0.157382241148738,0.314764482297476,0.157382241148738,1,-0.897657940036645,0.527186904631597}};
     // Create instance of filter stucture for battery voltage
-    Filter_Data_t voltage_Filter;
+    Filter_SOS_t voltage_Filter;
     // Initalize filter (might be good to add an if to the Initalize() call to reinitalize this too, if needed)
-    Filter_Init(&voltage_Filter, numerator_coeffs, denominator_coeffs, order);
-    // Initialize variables for saving unfltered & filtered voltage
-    float filtered_voltage   = 0;
-    float unfiltered_voltage = 0;
+    Filter_SOS_Init(&voltage_Filter, voltage_sos, sections);
+    // The battery monitor runs each ADC sample through the filter as Battery_Voltage collects them
+    Battery_Monitor_Attach_Filter(&voltage_Filter);
 
     ///////////////////////////
     //// System info stuff ////
     ///////////////////////////
     // Build a meaningful structure for storing data about timing for sending system info
     struct __attribute__((__packed__)) { float interval; Time_t startTime; Time_t last_trigger_time;} systemDataTime;
-    // Build a meaningful structure for storing data about system info
-    struct __attribute__((__packed__)) { float time; int16_t PWM_L; int16_t PWM_R; int16_t Encoder_L; int16_t Encoder_R;} systemData;
+    // System info is sent tagged with a format ID rather than its format string
+    uint8_t sys_format_id = usb_register_format("cf4h");
+    // Batched system info ('R') is staged here and sent K samples to a frame
+    USB_Batch_t sys_batch;
+    bool firstLoopSysBatch = true;
+    uint8_t sysBatchK = 0; // K the batch was set up with, a new 'R' with a different K re-packs the stream
+    struct __attribute__((__packed__)) { Time_t startTime; } sysBatchTime;
+    struct __attribute__((__packed__)) { float time; int16_t PWM_L; int16_t PWM_R; int16_t Encoder_L; int16_t Encoder_R;} sysBatchSample;
 
     //////////////////////////
     //// Controller stuff ////
     //////////////////////////
-    struct __attribute__((__packed__)) { Time_t startTime; Time_t last_trigger_time;} controlTime;
-    float distanceTraveled_Last_L;
-    float distanceTraveled_Last_R;
-    float angleTraveled_Last_L;
-    float angleTraveled_Last_R;
+    struct __attribute__((__packed__)) { Time_t startTime; } controlTime;
     float velocity_L;
     float velocity_R;
     float velocity_T;
     float angular_T;
-    float startRad_L;
-    float startRad_R;
-    float update_period = 0.005;
+    float update_period = CONTROL_PERIOD_US * 1e-6f;
     // Left track controller values
     uint8_t order_L = 1;
     float Kp_L = 138.6274;
     float numerator_coeffs_L[2] = {1,-0.925};
     float denominator_coeffs_L[2] = {8.7776,-8.7026};
-    Controller_t control_Filter_L;
     Controller_Init(&control_Filter_L,Kp_L,numerator_coeffs_L,denominator_coeffs_L,order_L,update_period);
     // Right track controller values
     uint8_t order_R = order_L;
     float Kp_R = 138.2969;
     float numerator_coeffs_R[2] = {1,-0.9249};
     float denominator_coeffs_R[2] = {8.8115,-8.7364};
-    Controller_t control_Filter_R;
     Controller_Init(&control_Filter_R,Kp_R,numerator_coeffs_R,denominator_coeffs_R,order_R,update_period);
 
     /////////////////////////////////
     //// Zumo car physical stuff ////
     /////////////////////////////////
-    float trackWheelDiameter = 0.035;          // [m] (aka 35 mm)
-    float trackWheelRadius = trackWheelDiameter/2;
     float trackSeparationDistance = 0.084;    // [m] (aka 84 mm)
 
 
+    // Start of the previous loop iteration, for the main loop period histogram
+    uint32_t loopStart = GetMicros32();
+
     for (;;){
+        uint32_t loopNow = GetMicros32();
+        Loop_Stats_Record(LOOP_STATS_MAIN_LOOP, loopNow - loopStart);
+        loopStart = loopNow;
+
         // USB_Echo_Task();
         USB_Upkeep_Task();
         Message_Handling_Task();
 
+        // Periodic report streams, earliest deadline first
+        MSG_Scheduler_Run();
+
+        // Deferred software timer callbacks
+        Timer_Wheel_Run();
+
         // [State-machine flag] Restart
         if(MSG_FLAG_Execute(&mf_restart)){
             // Reinitialize everything
             Initialize();
         }
 
-        // [State-machine flag] Send time
-        if(MSG_FLAG_Execute(&mf_send_time)){
-            command = mf_send_time.command;
-            timeData.B = mf_send_time.subcommand;
-            timeData.f = GetTimeSec();
-
-            usb_flush_input_buffer();
-
-            if(mf_send_time.duration <= 0){
-                usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
-                mf_send_time.active = false;
-            }else if(SecondsSince(&mf_send_time.last_trigger_time) >= mf_send_time.duration){
-                    usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
-                    mf_send_time.last_trigger_time = GetTime();
-            }
-        }
-
         // [State-machine flag] Time to complete loop
-        if(MSG_FLAG_Execute(&mf_loop_timer)){
+        if(mf_loop_timer.active){
             static Time_t loopTimeStart;    // struct to store loop time (static so it doesn't get deleted after this inner loop ends)
 
             if(firstLoop){
                 loopTimeStart = GetTime();   // fill loopTime struct
-            }else{
+            }else if(MSG_FLAG_Execute(&mf_loop_timer)){
                 command = mf_loop_timer.command;
                 timeData.B = mf_loop_timer.subcommand;
                 timeData.f = SecondsSince(&loopTimeStart);
 
                 usb_flush_input_buffer();
 
-                if(mf_loop_timer.duration <= 0){
+                if(mf_loop_timer.period == 0){
                     usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
                     mf_loop_timer.active = false;
-                }else if(SecondsSince(&mf_loop_timer.last_trigger_time) >= mf_loop_timer.duration){
+                }else{
                         usb_send_msg("cBf", command, &timeData, sizeof(timeData)); // send response
-                        mf_loop_timer.last_trigger_time = GetTime();
                 }
             }
             firstLoop = !firstLoop; // flip boolean since it is only checking the time of one loop
@@ -221,49 +349,22 @@ int main(void)
             USB_Upkeep_Task(); // wait for send (won't send without this)
             data.f = SecondsSince(&floatSendStart);   // get time since send
 
-            if(mf_time_float_send.duration <= 0){
+            if(mf_time_float_send.period == 0){
                 usb_send_msg("cBf", command, &data, sizeof(data)); // send response
                 mf_time_float_send.active = false;
             }
         }
 
-        // [State-machine flag] Send encoder counts
-        if(MSG_FLAG_Execute(&mf_send_encoder)){
-            // Build a meaningful structure to put encoder radians in into.
-            struct __attribute__((packed)) { float L_Rad; float R_Rad; } encoderData;
-            encoderData.L_Rad = Rad_Left();
-            encoderData.R_Rad = Rad_Right();
-
-            usb_flush_input_buffer();
-
-            if(mf_send_encoder.duration <= 0){
-                usb_send_msg("cff", 'e', &encoderData, sizeof(encoderData)); // send response
-                mf_send_encoder.active = false;
-            }else if(SecondsSince(&mf_send_encoder.last_trigger_time) >= mf_send_encoder.duration){
-                usb_send_msg("cff", 'E', &encoderData, sizeof(encoderData)); // send response
-                mf_send_encoder.last_trigger_time = GetTime();
-            }
-        }
-
         // Battery voltage measurement/monitor every 2 ms.
-        if(SecondsSince(&batVoltageFilter) >= batUpdateInterval){
-            // Get unfiltered battery voltage to help the filter smooth out quicker than sending it 0 to begin with
-            unfiltered_voltage = Battery_Voltage();
+        if(TicksSince(&batVoltageFilter) >= batUpdateTicks){
             // Set time battery voltage was retreived
             batVoltageFilter = GetTime();
 
-            if(firstLoopV){
-                // Initialize filter with unfiltered_voltage values
-                Filter_SetTo(&voltage_Filter,unfiltered_voltage);
-                firstLoopV = !firstLoopV; // flip boolean after first battery voltage read
-            }
-            // Set filtered voltage value
-            filtered_voltage = 2.0 * Filter_Value(&voltage_Filter,unfiltered_voltage);
+            // Set filtered voltage value (results arrive from the ADC ISR every 4 ms, this never waits on the ADC)
+            filtered_voltage = 2.0 * Battery_Voltage();
 
             // Send warning only every X seconds
-            if(SecondsSince(&battPwrWarnTimer) >= battPwrWarnInterval){
-                // Reset battery warning timer
-                battPwrWarnTimer = GetTime();
+            if(Timer_Wheel_Pending(BATT_WARN_TIMER)){
                 // Send warning if battery voltage below minimum voltage but power is NOT off
                 if(filtered_voltage <= minBatVoltage && filtered_voltage > offBattVoltage){
                     low_batt_msg.volt = filtered_voltage;
@@ -278,17 +379,6 @@ int main(void)
             }
         }
 
-        // [State-machine flag] Send battery voltage
-        if(MSG_FLAG_Execute(&mf_send_voltage)){
-            if(mf_send_voltage.duration <= 0){
-                usb_send_msg("cf", 'b', &filtered_voltage, sizeof(filtered_voltage));
-                mf_send_voltage.active = false;
-            }else if(SecondsSince(&mf_send_voltage.last_trigger_time) >= mf_send_voltage.duration){
-                usb_send_msg("cf", 'B', &filtered_voltage, sizeof(filtered_voltage));
-                mf_send_voltage.last_trigger_time = GetTime();
-            }
-        }
-
         // [State-machine flag] Set the motors
         if(MSG_FLAG_Execute(&mf_set_PWM)){
             Motor_PWM_Enable(true);
@@ -314,7 +404,7 @@ int main(void)
                 mf_set_PWM.active = false;
             }
 
-            else if(PWM_data.timed && SecondsSince(&mf_set_PWM.last_trigger_time) >= mf_set_PWM.duration){
+            else if(PWM_data.timed && TicksSince(&mf_set_PWM.last_trigger_time) >= (uint32_t)mf_set_PWM.time_limit){
                 mf_set_PWM.active = false;
                 mf_stop_PWM.active = true;
             }
@@ -322,6 +412,7 @@ int main(void)
 
         // [State-machine flag] Stop the motors
         if(MSG_FLAG_Execute(&mf_stop_PWM)){
+            Control_Tick_Stop();
             Motor_PWM_Left(0);
             Motor_PWM_Right(0);
             Motor_PWM_Enable(false);
@@ -338,170 +429,104 @@ int main(void)
                 firstLoopSysData = !firstLoopSysData;
             }
 
-            if(mf_send_sys_info.duration <= 0){
-                systemData.time      = SecondsSince(&systemDataTime.startTime);
-                systemData.PWM_L     = Get_Motor_PWM_Left();
-                systemData.PWM_R     = Get_Motor_PWM_Right();
-                systemData.Encoder_L = Rad_Left();
-                systemData.Encoder_R = Rad_Right();
-
-                usb_send_msg("cf4h",'q',&systemData,sizeof(systemData));
+            // Single reports ('q') go out once; periodic reports ('Q') go out every period
+            char sys_cmd = 0;
+            if(mf_send_sys_info.period == 0){
+                sys_cmd = 'q';
 
                 mf_send_sys_info.active = false;
 
                 firstLoopSysData = !firstLoopSysData;
 
-            }else if(SecondsSince(&systemDataTime.last_trigger_time) >= mf_send_sys_info.duration){
-                systemDataTime.last_trigger_time = GetTime();
+            }else{
+                sys_cmd = 'Q';
+            }
+
+            // Fields are written straight into the USB send buffer; nothing is sent if the frame does not fit
+            USB_Frame_t sys_frame;
+            if(sys_cmd && usb_frame_begin_id(&sys_frame, sys_format_id, sys_cmd, sizeof(float) + 4*sizeof(int16_t))){
+                float   time      = SecondsSince(&systemDataTime.startTime);
+                int16_t PWM_L     = Get_Motor_PWM_Left();
+                int16_t PWM_R     = Get_Motor_PWM_Right();
+                int16_t Encoder_L = Rad_Left();
+                int16_t Encoder_R = Rad_Right();
+
+                usb_frame_write(&sys_frame, &time,      sizeof(time));
+                usb_frame_write(&sys_frame, &PWM_L,     sizeof(PWM_L));
+                usb_frame_write(&sys_frame, &PWM_R,     sizeof(PWM_R));
+                usb_frame_write(&sys_frame, &Encoder_L, sizeof(Encoder_L));
+                usb_frame_write(&sys_frame, &Encoder_R, sizeof(Encoder_R));
+                usb_frame_commit(&sys_frame);
+            }
+        }
+
+        // [State-machine flag] Stream batched system information
+        if(MSG_FLAG_Execute(&mf_send_sys_batch)){
+            if(firstLoopSysBatch){
+                usb_batch_init(&sys_batch, sys_format_id, 'R', sizeof(sysBatchSample), mf_send_sys_batch.subcommand);
+                sysBatchK = mf_send_sys_batch.subcommand;
+                sysBatchTime.startTime = GetTime();
+                firstLoopSysBatch = false;
+            }else if(mf_send_sys_batch.subcommand != sysBatchK){
+                // K changed mid-stream: send what was packed at the old size, then continue at the new one
+                usb_batch_flush(&sys_batch);
+                usb_batch_init(&sys_batch, sys_format_id, 'R', sizeof(sysBatchSample), mf_send_sys_batch.subcommand);
+                sysBatchK = mf_send_sys_batch.subcommand;
+            }
+
+            if(mf_send_sys_batch.period == 0){
+                // Stream stopped: send the partial batch
+                usb_batch_flush(&sys_batch);
+                mf_send_sys_batch.active = false;
+                firstLoopSysBatch = true;
 
-                systemData.time      = SecondsSince(&systemDataTime.startTime);
-                systemData.PWM_L     = Get_Motor_PWM_Left();
-                systemData.PWM_R     = Get_Motor_PWM_Right();
-                systemData.Encoder_L = Rad_Left();
-                systemData.Encoder_R = Rad_Right();
+            }else{
+                sysBatchSample.time      = SecondsSince(&sysBatchTime.startTime);
+                sysBatchSample.PWM_L     = Get_Motor_PWM_Left();
+                sysBatchSample.PWM_R     = Get_Motor_PWM_Right();
+                sysBatchSample.Encoder_L = Rad_Left();
+                sysBatchSample.Encoder_R = Rad_Right();
 
-                usb_send_msg("cf4h",'Q',&systemData,sizeof(systemData));
+                usb_batch_add(&sys_batch, &sysBatchSample);
             }
         }
 
         // [State-machine flag] Distance mode
         if(MSG_FLAG_Execute(&mf_distance_mode)){
             if(firstLoopDist){
-                Filter_Init(&control_Filter_L, numerator_coeffs_L, denominator_coeffs_L, order_L);
-                Filter_Init(&control_Filter_R, numerator_coeffs_R, denominator_coeffs_R, order_R);
-                // usb_send_msg("cf", 'B', &filtered_voltage, sizeof(filtered_voltage));
-                distanceTraveled_Last_L = 0;
-                distanceTraveled_Last_R = 0;
-                float distanceTraveled_L = 0;
-                
-                float distanceTraveled_R = 0;
-                float angleTraveled_L = 0;
-                float angleTraveled_R = 0;
-                angleTraveled_Last_L = 0;
-                angleTraveled_Last_R = 0;
+                Control_Tick_Stop(); // the tick must not be using the controllers while they are reset
+                Filter_Init(&control_Filter_L.controller, numerator_coeffs_L, denominator_coeffs_L, order_L);
+                Filter_Init(&control_Filter_R.controller, numerator_coeffs_R, denominator_coeffs_R, order_R);
                 startRad_L = Rad_Left();
                 startRad_R = Rad_Right();
+                control_target = Dist_data;
                 controlTime.startTime = GetTime();
-                controlTime.last_trigger_time = GetTime();
                 firstLoopDist = false;
                 Motor_PWM_Enable(true);
+                // Controllers now run from the control tick
+                Control_Tick_Start(Distance_Step);
             }
 
-            if(mf_distance_mode.duration < 0 || SecondsSince(&controlTime.startTime) >= mf_distance_mode.duration){
+            if(mf_distance_mode.time_limit < 0 || TicksSince(&controlTime.startTime) >= (uint32_t)mf_distance_mode.time_limit){
                 mf_stop_PWM.active = true;
                 firstLoopDist = true;
-            }else{
-                struct __attribute__((packed)) { float L; float R; float T;} trackData;
-                struct __attribute__((packed)) { float L; float R; } PWData;
-                // Linear
-                float distanceTraveled_L = (Rad_Left() - startRad_L) * trackWheelRadius;
-                float distanceTraveled_R = (Rad_Right() - startRad_R) * trackWheelRadius;
-                float distanceTraveled_Total = (distanceTraveled_L + distanceTraveled_R)/2;
-                // Angular
-                float angleTraveled_L = distanceTraveled_L / trackWheelRadius;
-                float angleTraveled_R = distanceTraveled_R / trackWheelRadius;
-                float angleTraveled_Total = (angleTraveled_R - angleTraveled_L)/2;
-
-                trackData.L = angleTraveled_L;
-                trackData.R = angleTraveled_R;
-                trackData.T = angleTraveled_Total;
-
-                // Move distance
-                if(angleTraveled_Total < Dist_data.angular && Dist_data.angular != 0){
-                    if(SecondsSince(&controlTime.last_trigger_time) >= update_period){
-                        control_Filter_L.target_pos = -Dist_data.angular;
-                        control_Filter_R.target_pos = Dist_data.angular;
-                        // Motor_PWM_Left(Controller_Update(&control_Filter_L, angleTraveled_L - angleTraveled_Last_L, SecondsSince(&controlTime.last_trigger_time)));
-                        // Motor_PWM_Right(Controller_Update(&control_Filter_R, angleTraveled_R - angleTraveled_Last_R, SecondsSince(&controlTime.last_trigger_time)));
-
-                        PWData.L = Controller_Update(&control_Filter_L, angleTraveled_L, SecondsSince(&controlTime.last_trigger_time));
-                        PWData.R = Controller_Update(&control_Filter_R, angleTraveled_R, SecondsSince(&controlTime.last_trigger_time));
-
-                        usb_send_msg("cff", 'p', &PWData, sizeof(PWData));
-
-                        if(PWData.R < 0){
-                            PORTB |= (1 << PB1);
-                            PWData.R = -PWData.R;
-                        }else{
-                            PORTB &= ~(1 << PB1);
-                        }
-
-                        if(PWData.L < 0){
-                            PORTB |= (1 << PB2);
-                            PWData.L = -PWData.L;
-                        }else{
-                            PORTB &= ~(1 << PB2);
-                        }
-
-                        Motor_PWM_Left(PWData.L);
-                        Motor_PWM_Right(PWData.R);
-
-                        // Save travel distance
-                        angleTraveled_Last_L = angleTraveled_L - angleTraveled_Last_L;
-                        angleTraveled_Last_R = angleTraveled_R - angleTraveled_Last_R;
-
-                        controlTime.last_trigger_time = GetTime();
-
-                        // usb_send_msg("cfff", 'I', &trackData, sizeof(trackData));
-                    }
-                // }else if(secondLoopDist && angleTraveled_Total > Dist_data.angular){
-                //     distanceTraveled_Last_L = 0;
-                //     distanceTraveled_Last_R = 0;
-                //     startRad_L = Rad_Left();
-                //     startRad_R = Rad_Right();
-                //     secondLoopDist = false;
-                }else if(distanceTraveled_Total < Dist_data.linear){
-                    if(SecondsSince(&controlTime.last_trigger_time) >= update_period){
-                        control_Filter_L.target_pos = Dist_data.linear;
-                        control_Filter_R.target_pos = Dist_data.linear;
-
-                        PWData.L = Controller_Update(&control_Filter_L, distanceTraveled_L, SecondsSince(&controlTime.last_trigger_time));
-                        PWData.R = Controller_Update(&control_Filter_R, distanceTraveled_R, SecondsSince(&controlTime.last_trigger_time));
-
-                        usb_send_msg("cff", 'p', &PWData, sizeof(PWData));
-                        // usb_send_msg("cf",'k',&distanceTraveled_Total,sizeof(distanceTraveled_Total));
-
-                        if(PWData.R < 0){
-                            PORTB |= (1 << PB1);
-                            PWData.R = -PWData.R;
-                        }else{
-                            PORTB &= ~(1 << PB1);
-                        }
-
-                        if(PWData.L < 0){
-                            PORTB |= (1 << PB2);
-                            PWData.L = -PWData.L;
-                        }else{
-                            PORTB &= ~(1 << PB2);
-                        }
-
-                        Motor_PWM_Left(PWData.L);
-                        Motor_PWM_Right(PWData.R);
-
-                        // Save travel distance
-                        distanceTraveled_Last_L = distanceTraveled_L - distanceTraveled_Last_L;
-                        distanceTraveled_Last_R = distanceTraveled_R - distanceTraveled_Last_R;
-
-                        controlTime.last_trigger_time = GetTime();
-
-                        // usb_send_msg("cff", 'I', &trackData, sizeof(trackData));
-                    }
-                }else{
-                    mf_send_encoder.active = true;
-	                firstLoopDist = true;
-                    mf_stop_PWM.active = true;
-                }
+            }else if(!Control_Tick_Is_Running()){
+                // Distance_Step reached the target
+                mf_send_encoder.active = true;
+                firstLoopDist = true;
+                mf_stop_PWM.active = true;
             }
         }
 
         // [State-machine flag] Velocity mode
         if(MSG_FLAG_Execute(&mf_velocity_mode)){
             if(firstLoopVeloc){
-                Filter_Init(&voltage_Filter, numerator_coeffs, denominator_coeffs, order);
+                Control_Tick_Stop(); // the tick must not be using the controllers while they are reset
+                Filter_SOS_Init(&voltage_Filter, voltage_sos, sections);
+                Battery_Monitor_Attach_Filter(&voltage_Filter); // restart the battery filter from the next sample
                 startRad_L = Rad_Left();
                 startRad_R = Rad_Right();
                 controlTime.startTime = GetTime();
-                controlTime.last_trigger_time = GetTime();
                 firstLoopVeloc = !firstLoopVeloc;
                 Motor_PWM_Enable(true);
 
@@ -510,46 +535,15 @@ int main(void)
 
                 control_Filter_L.target_vel = velocity_L;
                 control_Filter_R.target_vel = velocity_R;
+
+                // Controllers now run from the control tick
+                Control_Tick_Start(Velocity_Step);
             }
 
-            if(mf_velocity_mode.duration < 0 || SecondsSince(&controlTime.startTime) >= mf_velocity_mode.duration){
+            if(mf_velocity_mode.time_limit < 0 || TicksSince(&controlTime.startTime) >= (uint32_t)mf_velocity_mode.time_limit){
                 mf_stop_PWM.active = true;
                 firstLoopVeloc = !firstLoopVeloc;
                 mf_velocity_mode.active = false;
-            }else{
-                struct __attribute__((packed)) { float L; float R; } PWData;
-
-                if(SecondsSince(&controlTime.last_trigger_time) >= update_period){
-                    float distanceTraveled_L = (Rad_Left() - startRad_L) * trackWheelRadius;
-                    float distanceTraveled_R = (Rad_Right() - startRad_R) * trackWheelRadius;
-
-                    distanceTraveled_L = distanceTraveled_L / SecondsSince(&controlTime.last_trigger_time);
-                    distanceTraveled_R = distanceTraveled_R / SecondsSince(&controlTime.last_trigger_time);
-
-                    PWData.L = Controller_Update(&control_Filter_L, distanceTraveled_L, SecondsSince(&controlTime.last_trigger_time));
-                    PWData.R = Controller_Update(&control_Filter_R, distanceTraveled_R, SecondsSince(&controlTime.last_trigger_time));
-
-                        if(PWData.R < 0){
-                            PORTB |= (1 << PB1);
-                            PWData.R = -PWData.R;
-                        }else{
-                            PORTB &= ~(1 << PB1);
-                        }
-
-                        if(PWData.L < 0){
-                            PORTB |= (1 << PB2);
-                            PWData.L = -PWData.L;
-                        }else{
-                            PORTB &= ~(1 << PB2);
-                        }
-
-                        Motor_PWM_Left(PWData.L);
-                        Motor_PWM_Right(PWData.R);
-
-                    controlTime.last_trigger_time = GetTime();
-
-                    // usb_send_msg("cff", 'P', &PWData, sizeof(PWData));
-                }
             }
         }
     }
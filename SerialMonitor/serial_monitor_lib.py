@@ -51,6 +51,12 @@ import matplotlib.animation as animation
 from matplotlib.backends.backend_tkagg import(FigureCanvasTkAgg,NavigationToolbar2Tk)
 
 
+# FRAME MARKERS FOR THE DEVICE'S FORMAT REGISTRY (see USB_FRAME_FORMAT_ID in c_lib/SerialIO.h)
+FORMAT_ID_FRAME = 0x01
+FORMAT_ANNOUNCE_FRAME = 0x02
+FORMAT_BATCH_FRAME = 0x03
+
+
 class SerialData:
     def __init__(self):
 
@@ -68,6 +74,7 @@ class SerialData:
         self.dataNumBytes = -1
         self.dataFormat = "<"
         self.rawData = None
+        self.formatTable = {} # format id -> struct format, learned from the device's announcement frames
 
     def openPort (self, serialPort='COM5', serialBaud=9600):
         
@@ -84,7 +91,9 @@ class SerialData:
                 self.serialConnection.open()
                 
             print('Connected to ' + str(serialPort) + ' at ' + str(serialBaud) + ' BAUD.')
+            self.formatTable = {}
             self.readSerialStart()
+            self.serialConnection.write(b'#') # ask the device to re-announce its format ids
         except:
             print("Failed to connect with " + str(serialPort) + ' at ' + str(serialBaud) + ' BAUD.')
 
@@ -200,7 +209,12 @@ class SerialData:
                     self.dataNumBytes -= 1
                     tmp_uchar = struct.unpack('b',tmp)[0]
                     
-                    if tmp_uchar is not 0:
+                    if self.dataFormat == "<" and tmp_uchar in (FORMAT_ID_FRAME, FORMAT_ANNOUNCE_FRAME, FORMAT_BATCH_FRAME):
+                        self.readFormatRegistryFrame(tmp_uchar)
+                        self.dataNumBytes = -1
+                        self.dataFormat = "<"
+                    
+                    elif tmp_uchar is not 0:
                         self.dataFormat = self.dataFormat + struct.unpack('c',tmp)[0].decode('ascii')
                         try:
                             try:
@@ -241,6 +255,52 @@ class SerialData:
                 self.serialConnection.close()
                 print('Connection Lost\n')
                 
+    def readExactly(self, num_bytes):
+        while self.isRun and self.serialConnection.in_waiting < num_bytes:
+            time.sleep(0.001)
+        
+        self.serial_read_write_mutex.acquire()
+        try:
+            return self.serialConnection.read(num_bytes)
+        finally:
+            self.serial_read_write_mutex.release()
+    
+    def readFormatRegistryFrame(self, marker):
+        # [len][marker] already read, self.dataNumBytes bytes remain:
+        #   [id][cmd][data], [id][format\0], or [id][count][cmd][sample]*count
+        body = self.readExactly(self.dataNumBytes)
+        if len(body) < 1:
+            return
+        
+        format_id = body[0]
+        if marker == FORMAT_ANNOUNCE_FRAME:
+            self.formatTable[format_id] = "<" + body[1:].split(b'\0')[0].decode('ascii')
+        
+        elif format_id in self.formatTable and marker == FORMAT_BATCH_FRAME:
+            # each row is the command char followed by one sample
+            self.dataFormat = self.formatTable[format_id]
+            row_size = struct.calcsize(self.dataFormat)
+            if len(body) < 3 or row_size < 1:
+                return
+            count = body[1]
+            cmd = body[2:3]
+            samples = body[3:]
+            sample_size = row_size - 1
+            if sample_size * count != len(samples):
+                return
+            for i in range(count):
+                self.rawData = bytearray(cmd + samples[i*sample_size:(i+1)*sample_size])
+                self.parseData()
+        
+        elif format_id in self.formatTable:
+            self.dataFormat = self.formatTable[format_id]
+            if struct.calcsize(self.dataFormat) == len(body) - 1:
+                self.rawData = bytearray(body[1:])
+                self.parseData()
+        
+        else:
+            print("Unknown format id: " + str(format_id))
+    
     def write(self, data, data_format):
         try:
             index = 0
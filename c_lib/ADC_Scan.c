@@ -0,0 +1,204 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "ADC_Scan.h"
+#include "Ring_Buffer.h"
+
+#include <util/atomic.h> // results are written by the ADC ISR
+
+_Static_assert(ADC_SCAN_COUNT > 0 && ADC_SCAN_COUNT <= 9, "ADC_Scan: a burst of conversions must fit in 1 ms");
+
+#define ADC_SCAN_CHECK(NAME, CHANNEL, OVERSAMPLE) \
+    _Static_assert((CHANNEL) <= 13 && (OVERSAMPLE) <= 6, "ADC_Scan: " #NAME " needs an ADC channel 0-13 and at most 6 oversample bits");
+ADC_SCAN_CHANNEL_LIST(ADC_SCAN_CHECK)
+#undef ADC_SCAN_CHECK
+
+#define ADC_SCAN_MUX(NAME, CHANNEL, OVERSAMPLE) CHANNEL,
+static const uint8_t _adc_scan_channel[ADC_SCAN_COUNT] = { ADC_SCAN_CHANNEL_LIST(ADC_SCAN_MUX) };
+#undef ADC_SCAN_MUX
+
+#define ADC_SCAN_OVERSAMPLE(NAME, CHANNEL, OVERSAMPLE) OVERSAMPLE,
+static const uint8_t _adc_scan_oversample[ADC_SCAN_COUNT] = { ADC_SCAN_CHANNEL_LIST(ADC_SCAN_OVERSAMPLE) };
+#undef ADC_SCAN_OVERSAMPLE
+
+// Results are handed from the ADC ISR (producer) to the main loop (consumer)
+RB_SPSC_DECLARE( ADCS, uint16_t, ADC_SCAN_RING_LENGTH );
+RB_SPSC_DEFINE ( ADCS, uint16_t, ADC_SCAN_RING_LENGTH )
+
+typedef struct {
+    uint32_t sum;               // samples accumulated toward the next result
+    uint16_t count;             // samples in sum
+    volatile uint16_t latest;   // most recent result
+    volatile uint16_t dropped;  // results lost to a full ring
+    Ring_Buffer_ADCS_t ring;
+} ADC_Scan_State_t;
+
+static ADC_Scan_State_t _adc_scan[ADC_SCAN_COUNT];
+static volatile uint8_t _adc_scan_index;    // channel being converted
+
+// Auto trigger source: Timer0 Compare Match A (Sec. 24.9.4)
+#define ADC_SCAN_TRIGGER ((1 << ADTS1) | (1 << ADTS0))
+
+/**
+ * Function _adc_scan_select points the multiplexer at a channel in the list. Only call between conversions.
+ * @param index [uint8_t] channel in the list
+ */
+static inline void _adc_scan_select( uint8_t index )
+{
+    uint8_t channel = _adc_scan_channel[index];
+
+    // AVcc reference, right adjusted result (Sec. 24.9.1); channels 8-13 set MUX5 in ADCSRB (Sec. 24.9.4)
+    ADMUX  = (1 << REFS0) | (channel & 0x07);
+    ADCSRB = ADC_SCAN_TRIGGER | ((channel & 0x08) ? (1 << MUX5) : 0);
+}
+
+/**
+ * Function ADC_Scan_Init sets up the ADC, clears every channel and starts scanning on the next Timer0 compare.
+ * SetupTimer0 must be running for the scan to be triggered.
+ */
+void ADC_Scan_Init()
+{
+    // Stop the ADC (and its ISR) while the channel state is reset
+    ADCSRA = 0;
+
+    for( uint8_t i = 0; i < ADC_SCAN_COUNT; i++ ){
+        _adc_scan[i].sum     = 0;
+        _adc_scan[i].count   = 0;
+        _adc_scan[i].latest  = 0;
+        _adc_scan[i].dropped = 0;
+        rb_initialize_ADCS(&_adc_scan[i].ring);
+
+        // Disable the digital input buffer of scanned pins (Sec. 24.9.5 & 24.9.6)
+        uint8_t channel = _adc_scan_channel[i];
+        if( channel < 8 ){
+            DIDR0 |= (1 << channel);
+        }else{
+            DIDR2 |= (1 << (channel - 8));
+        }
+    }
+
+    _adc_scan_index = 0;
+    _adc_scan_select(0);
+
+    // Enable, auto trigger, interrupt on completion, prescaler of 128: 16MHz/128 = 125kHz is within the
+    // 50kHz-200kHz range for full resolution (Sec 24.9.2)
+    ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIF) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+/**
+ * Function ADC_Scan_Latest returns a channel's most recent (decimated) result.
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @return [uint16_t] result with ADC_Scan_Bits(channel) bits, 0 before the first result
+ */
+uint16_t ADC_Scan_Latest( ADC_Scan_Channel_t channel )
+{
+    if( channel >= ADC_SCAN_COUNT ) return 0;
+
+    uint16_t latest;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        latest = _adc_scan[channel].latest;
+    }
+    return latest;
+}
+
+/**
+ * Function ADC_Scan_Pop removes the oldest buffered result of a channel.
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @param p_value [uint16_t*] filled with the result
+ * @return [bool] false if no result is waiting
+ */
+bool ADC_Scan_Pop( ADC_Scan_Channel_t channel, uint16_t* p_value )
+{
+    if( channel >= ADC_SCAN_COUNT ) return false;
+
+    return rb_pop_front_ADCS(&_adc_scan[channel].ring, p_value);
+}
+
+/**
+ * Function ADC_Scan_Bits returns the resolution of a channel's results (10 plus its oversample bits).
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @return [uint8_t] bits per result
+ */
+uint8_t ADC_Scan_Bits( ADC_Scan_Channel_t channel )
+{
+    if( channel >= ADC_SCAN_COUNT ) return 0;
+
+    return 10 + _adc_scan_oversample[channel];
+}
+
+/**
+ * Function ADC_Scan_Dropped returns how many results of a channel were lost because its ring was full.
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @return [uint16_t] dropped results
+ */
+uint16_t ADC_Scan_Dropped( ADC_Scan_Channel_t channel )
+{
+    if( channel >= ADC_SCAN_COUNT ) return 0;
+
+    uint16_t dropped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        dropped = _adc_scan[channel].dropped;
+    }
+    return dropped;
+}
+
+/**
+ * Interrupt Service Routine for a completed conversion (Sec. 24.9.2). Accumulates the sample, publishes a result
+ * once the channel has 4^b samples, then starts the next channel of the burst or waits for the next trigger.
+ */
+ISR(ADC_vect)
+{
+    uint8_t index = _adc_scan_index;
+    ADC_Scan_State_t* p_state = &_adc_scan[index];
+    uint8_t oversample = _adc_scan_oversample[index];
+
+    p_state->sum += ADC;
+    if( ++p_state->count >= (1u << (2 * oversample)) ){
+        uint16_t result = p_state->sum >> oversample;
+        p_state->sum   = 0;
+        p_state->count = 0;
+
+        p_state->latest = result;
+        if( !rb_push_back_ADCS(&p_state->ring, result) ){
+            p_state->dropped++;
+        }
+    }
+
+    if( ++index < ADC_SCAN_COUNT ){
+        // Rest of the burst: switch channel and start the conversion by hand
+        _adc_scan_index = index;
+        _adc_scan_select(index);
+        ADCSRA |= (1 << ADSC);
+    }else{
+        // Burst done, the next Timer0 compare starts the first channel again
+        _adc_scan_index = 0;
+        _adc_scan_select(0);
+    }
+}
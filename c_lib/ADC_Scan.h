@@ -0,0 +1,106 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * ADC_Scan.h/c converts a fixed list of analog channels in the background, so nothing else touches the ADC
+ * registers. See Section 24 of the atmega32U4 datasheet.
+ *
+ * Every Timer0 compare match (1 kHz, see Timing.h) auto-triggers a burst: the ADC_vect ISR converts each channel in
+ * the list once, switching the multiplexer and starting the next conversion itself, then waits for the next
+ * trigger. A conversion takes 104 us at the 125 kHz ADC clock, so the list must stay short enough for a burst to
+ * fit in 1 ms (at most 9 channels).
+ *
+ * Each channel can be oversampled: with oversample bits b, 4^b consecutive samples (one per burst) are summed and
+ * shifted right by b, giving a 10+b bit result at 1000/4^b Hz with the noise averaged down. Every result is kept as
+ * the channel's latest value and pushed into the channel's sample ring.
+ *
+ * The channel list is set at compile time by ADC_SCAN_CHANNEL_LIST. Each entry is
+ *     X( name, adc_channel, oversample_bits )
+ * and name becomes the channel's index in the ADC_Scan functions. ADC channels 0-7 are ADMUX channels (ADC6 is
+ * PF6), 8-13 use MUX5. The Zumo 32U4 has no motor current sense, so the list is the battery and a spare pin.
+ * The battery's oversampling sets its sample rate, which the Lab5 battery filter is designed for; re-derive that
+ * filter if it changes.
+ */
+#ifndef _ADC_SCAN_H
+#define _ADC_SCAN_H
+
+#include <avr/interrupt.h> // For ISR
+#include <avr/io.h>        // For ADC registers
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef ADC_SCAN_CHANNEL_LIST
+#define ADC_SCAN_CHANNEL_LIST(X)                                                                  \
+    X( ADC_SCAN_BATTERY, 6, 1 ) /* ADC6/PF6, battery voltage / 2: 11 bits at 250 Hz */            \
+    X( ADC_SCAN_SPARE,   7, 2 ) /* ADC7/PF7, spare analog pin A0: 12 bits at 62.5 Hz */
+#endif
+
+#define ADC_SCAN_ENUM(NAME, CHANNEL, OVERSAMPLE) NAME,
+typedef enum { ADC_SCAN_CHANNEL_LIST(ADC_SCAN_ENUM) ADC_SCAN_COUNT } ADC_Scan_Channel_t;
+#undef ADC_SCAN_ENUM
+
+#define ADC_SCAN_RING_LENGTH 8  // per channel results buffered, a power of 2 (holds one less)
+
+/**
+ * Function ADC_Scan_Init sets up the ADC, clears every channel and starts scanning on the next Timer0 compare.
+ * SetupTimer0 must be running for the scan to be triggered.
+ */
+void ADC_Scan_Init();
+
+/**
+ * Function ADC_Scan_Latest returns a channel's most recent (decimated) result.
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @return [uint16_t] result with ADC_Scan_Bits(channel) bits, 0 before the first result
+ */
+uint16_t ADC_Scan_Latest( ADC_Scan_Channel_t channel );
+
+/**
+ * Function ADC_Scan_Pop removes the oldest buffered result of a channel.
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @param p_value [uint16_t*] filled with the result
+ * @return [bool] false if no result is waiting
+ */
+bool ADC_Scan_Pop( ADC_Scan_Channel_t channel, uint16_t* p_value );
+
+/**
+ * Function ADC_Scan_Bits returns the resolution of a channel's results (10 plus its oversample bits).
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @return [uint8_t] bits per result
+ */
+uint8_t ADC_Scan_Bits( ADC_Scan_Channel_t channel );
+
+/**
+ * Function ADC_Scan_Dropped returns how many results of a channel were lost because its ring was full.
+ * @param channel [ADC_Scan_Channel_t] channel in the list
+ * @return [uint16_t] dropped results
+ */
+uint16_t ADC_Scan_Dropped( ADC_Scan_Channel_t channel );
+
+#endif
@@ -1,66 +1,86 @@
 #include "Battery_Monitor.h"
+#include "ADC_Scan.h"
+#include "Profile.h"
+
+#include <stddef.h>
+#include <util/delay.h> // for the first reading at init
 
-/*
-NOT SURE WHAT TO DO HERE!!!!
-*/
 static const float BITS_TO_BATTERY_VOLTS = 5.0/1023.0;
 
+static Filter_SOS_t* _p_battery_filter = NULL; // filter the samples run through, NULL for none
+static bool  _battery_filter_primed;             // filter has been set to its first sample
+static float _battery_volts;                     // latest (filtered) voltage
+
 /**
  * Function Battery_Monitor_Init initializes the Battery Monitor to record the current battery voltages.
+ * The readings come from the ADC_SCAN_BATTERY channel of the ADC scan, which this (re)starts.
  */
 void Battery_Monitor_Init()
 {
-    // Disable digital inputs
-    DIDR0 = 0;
-    //// VBAT pin PF6/ADC6 (aka A1) ////
-    // Enable ADC (Sec. 24.9.2)
-    ADCSRA |= (1 << ADEN);
+    _battery_filter_primed = false;
+    _battery_volts = 0;
 
-    // Set prescalor to 128 (Sec 24.9.2)
-    // Need within 50kHz-200kHz range: 16MHz/128 = 125kHz
-    ADCSRA |= (1 << ADPS2);
-    ADCSRA |= (1 << ADPS1);
-    ADCSRA |= (1 << ADPS0);
+    ADC_Scan_Init();
 
-    // Set internal 2.56V reference with external capacitor on AREF pin (Sec.24.9.1)
-    ADMUX |= (0 << REFS1);
-    ADMUX |= (1 << REFS0);
-
-    ADMUX &= ~(1 << ADLAR);
+    // Wait (at most ~10 ms, interrupts on) for the first reading so Battery_Voltage does not start at 0
+    uint16_t sample;
+    for(uint8_t i = 0; i < 100; i++){
+        if(ADC_Scan_Pop(ADC_SCAN_BATTERY, &sample)){
+            _battery_volts = (float) sample * BITS_TO_BATTERY_VOLTS / (1 << (ADC_Scan_Bits(ADC_SCAN_BATTERY) - 10));
+            break;
+        }
+        _delay_us(100);
+    }
+}
 
-    // Enable ADC6 as input (Sec.24.9.1)
+/**
+ * Function Battery_Monitor_Attach_Filter sets the filter that Battery_Voltage runs every new sample through.
+ * The filter is set to the first sample it sees so it does not start from zero.
+ * @param p_filt [Filter_SOS_t*] initialized filter, NULL to report unfiltered samples
+ */
+void Battery_Monitor_Attach_Filter( Filter_SOS_t* p_filt )
+{
+    _p_battery_filter = p_filt;
+    _battery_filter_primed = false;
 }
 
 /**
- * Function Battery_Voltage initiates the A/D measurement and returns the result for the battery voltage.
+ * Function Battery_Voltage returns the latest battery reading in volts at the ADC pin without waiting on the
+ * ADC. Every sample converted since the last call is first run through the attached filter (if any).
+ * @return [float] latest (filtered) voltage
  */
 float Battery_Voltage()
 {
-    // A Union to assist with reading the LSB and MSB in the 16 bit register
-    union { struct {uint8_t LSB; uint8_t MSB; } split; uint16_t value;} data;
+    PROFILE_BEGIN(PROFILE_BATTERY_VOLTAGE);
+
+    // Scan results carry extra oversampled bits, scale them back to 10-bit counts
+    const float bits_to_volts = BITS_TO_BATTERY_VOLTS / (1 << (ADC_Scan_Bits(ADC_SCAN_BATTERY) - 10));
 
-    // Needs to be set each time
-    ADMUX |= (1 << MUX2);
-    ADMUX |= (1 << MUX1);
-    
-    // Store interrupt settings (this is like ATOMIC_BLOCK(ATOMIC_FORCEON) (Sec. 14.2)
-    char SREG_copy = SREG;
-        // Disable global interrupts
-        // __disable_interrupt();
-        cli();
-        // Start ADC conversion (resets itself to 0 after conversion complete) (Sec. 24.9.2)
-        ADCSRA |= (1 << ADSC);
-        
-        while(ADCSRA & (1<<ADSC)){
-            
+    uint16_t sample;
+    while(ADC_Scan_Pop(ADC_SCAN_BATTERY, &sample)){
+        float volts = (float) sample * bits_to_volts;
+
+        if(_p_battery_filter == NULL){
+            _battery_volts = volts;
+        }else{
+            if(!_battery_filter_primed){
+                Filter_SOS_SetTo(_p_battery_filter, volts);
+                _battery_filter_primed = true;
+            }
+            _battery_volts = Filter_SOS_Value(_p_battery_filter, volts);
         }
+    }
 
-        // Save ADC Low byte into union stuct (Sec. 24.9.3)
-            data.split.LSB = ADCL;
-            // Save ADC high byte into union struct
-            data.split.MSB = ADCH;
-    // Restore interrupt settings
-    SREG = SREG_copy;
+    PROFILE_END(PROFILE_BATTERY_VOLTAGE);
+    return _battery_volts;
+}
 
-    return (float) data.value * BITS_TO_BATTERY_VOLTS;
+/**
+ * Function Battery_Samples_Dropped returns how many readings were lost because Battery_Voltage was not called
+ * often enough to empty the scan's battery ring.
+ * @return [uint16_t] dropped samples
+ */
+uint16_t Battery_Samples_Dropped()
+{
+    return ADC_Scan_Dropped(ADC_SCAN_BATTERY);
 }
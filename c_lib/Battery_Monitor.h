@@ -35,6 +35,10 @@
  *
  * The battery voltage is divided by 2 before being connected to ADC6 (PF6).
  *
+ * The pin is read in the background by the ADC scan (ADC_Scan.h, channel ADC_SCAN_BATTERY), which needs
+ * SetupTimer0 running. Battery_Voltage drains the channel's results through an optional filter; it never touches
+ * the ADC registers, waits on a conversion, or disables interrupts.
+ *
  */
 #ifndef _LAB3_BATTERY_MONITOR_H
 #define _LAB3_BATTERY_MONITOR_H
@@ -42,6 +46,9 @@
 #include <avr/interrupt.h> // For Interrupts
 #include <avr/io.h>        // For pin input/output access
 #include <ctype.h>         // For int32_t type
+#include <stdbool.h>       // For bool type
+
+#include "Filter.h"        // For the optional battery filter
 
 /**
  * Function Battery_Monitor_Init initializes the Battery Monitor to record the current battery voltages.
@@ -49,10 +56,26 @@
 void Battery_Monitor_Init();
 
 /**
- * Function Battery_Voltage initiates the A/D measurement and returns the result for the battery voltage.
+ * Function Battery_Monitor_Attach_Filter sets the filter that Battery_Voltage runs every new sample through.
+ * The filter is set to the first sample it sees so it does not start from zero.
+ * @param p_filt [Filter_SOS_t*] initialized filter, NULL to report unfiltered samples
+ */
+void Battery_Monitor_Attach_Filter( Filter_SOS_t* p_filt );
+
+/**
+ * Function Battery_Voltage returns the latest battery reading in volts at the ADC pin without waiting on the
+ * ADC. Every sample converted since the last call is first run through the attached filter (if any).
+ * @return [float] latest (filtered) voltage
  */
 float Battery_Voltage();
 
+/**
+ * Function Battery_Samples_Dropped returns how many readings were lost because Battery_Voltage was not called
+ * often enough to empty the scan's battery ring.
+ * @return [uint16_t] dropped samples
+ */
+uint16_t Battery_Samples_Dropped();
+
 
 
 
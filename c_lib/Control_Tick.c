@@ -0,0 +1,305 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Control_Tick.h"
+#include "Encoder.h"
+#include "MotorPWM.h"
+#include "Loop_Stats.h"
+
+#include <stddef.h>
+#include <util/atomic.h> // tick state is shared with the Timer3 ISR
+
+#define CONTROL_TICK_COUNTS_PER_US (F_CPU / 1000000UL)  // Timer3 counts per microsecond at clk/1
+#define CONTROL_TICK_MIN_PERIOD_US 100
+#define CONTROL_TICK_MAX_STEP      0xFFFFUL             // longest compare step the 16-bit timer can schedule
+
+static volatile Control_Tick_Step_t _step_fn;   // step function, NULL when stopped
+static volatile bool _running;
+static volatile bool _in_tick;                  // re-entry guard for the tick body
+
+static uint16_t _period_us;     // [us] control period
+static float    _dt;            // [s] control period
+static uint16_t _step_counts;   // Timer3 counts per compare step
+static uint8_t  _steps;         // compare steps per control period (software postscaler)
+static uint8_t  _long_steps;    // the first _long_steps steps are one count longer, so the steps sum to the period
+static volatile uint8_t _step_index;
+static uint32_t _tick_count;
+static uint16_t _last_latency; // previous tick's latency, for the tick-to-tick period
+static bool     _have_last;    // _last_latency belongs to the tick just before this one
+static int16_t  _max_pwm;       // Get_MAX_Motor_PWM() cached at start, ICR1 is not read from the ISR
+
+static volatile Control_Tick_Stats_t _stats;
+
+/**
+ * Function _timer3_now reads TCNT3. The 16-bit read goes through the shared TEMP register, so it is done with
+ * interrupts off (the tick body runs with them on).
+ * @return [uint16_t] current Timer3 count
+ */
+static inline uint16_t _timer3_now()
+{
+    uint16_t now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        now = TCNT3;
+    }
+    return now;
+}
+
+/**
+ * Function _step_length returns the length of a compare step in Timer3 counts.
+ * @param index [uint8_t] step within the control period
+ * @return [uint16_t] counts until the end of that step
+ */
+static inline uint16_t _step_length( uint8_t index )
+{
+    return _step_counts + (index < _long_steps ? 1 : 0);
+}
+
+/**
+ * Function _write_pwm drives both motors from signed PWM values: the sign sets the direction pin (PB2 left,
+ * PB1 right) and the magnitude, clamped to the PWM TOP, the duty cycle.
+ * @param left [int16_t] left PWM
+ * @param right [int16_t] right PWM
+ */
+static void _write_pwm( int16_t left, int16_t right )
+{
+    if( left  >  _max_pwm ) left  =  _max_pwm;
+    if( left  < -_max_pwm ) left  = -_max_pwm;
+    if( right >  _max_pwm ) right =  _max_pwm;
+    if( right < -_max_pwm ) right = -_max_pwm;
+
+    if( right < 0 ){
+        PORTB |= (1 << PB1);
+        right = -right;
+    }else{
+        PORTB &= ~(1 << PB1);
+    }
+
+    if( left < 0 ){
+        PORTB |= (1 << PB2);
+        left = -left;
+    }else{
+        PORTB &= ~(1 << PB2);
+    }
+
+    Motor_PWM_Left(left);
+    Motor_PWM_Right(right);
+}
+
+/**
+ * Function Control_Tick_Init starts Timer3 free-running at the CPU clock and sets the control period. The tick
+ * interrupt stays off until Control_Tick_Start.
+ * @param period_us [uint16_t] control period in microseconds (at least 100 us)
+ */
+void Control_Tick_Init( uint16_t period_us )
+{
+    Control_Tick_Stop();
+
+    if( period_us < CONTROL_TICK_MIN_PERIOD_US ){
+        period_us = CONTROL_TICK_MIN_PERIOD_US;
+    }
+
+    // Split the period into the fewest compare steps that fit the 16-bit timer
+    uint32_t counts = (uint32_t) period_us * CONTROL_TICK_COUNTS_PER_US;
+    _steps       = (counts + CONTROL_TICK_MAX_STEP - 1) / CONTROL_TICK_MAX_STEP;
+    _step_counts = counts / _steps;
+    _long_steps  = counts % _steps;
+    _period_us   = period_us;
+    _dt          = period_us * 1e-6f;
+
+    // Normal mode, no prescaler (Sec. 14.10.1 & 14.10.3)
+    TCCR3A = 0;
+    TCCR3B = (1 << CS30);
+
+    // Period histogram: 8 us bins centred on the period, late past the top bin. Execution histogram: bins spanning
+    // the period, late past the period.
+    uint8_t exec_shift = 0;
+    while( ((uint32_t) LOOP_STATS_BINS << exec_shift) < period_us ){
+        exec_shift++;
+    }
+    Loop_Stats_Configure(LOOP_STATS_CONTROL_PERIOD, period_us - (LOOP_STATS_BINS / 2) * 8, 3,
+                         period_us + (LOOP_STATS_BINS / 2) * 8);
+    Loop_Stats_Configure(LOOP_STATS_CONTROL_EXEC, 0, exec_shift, period_us);
+
+    Control_Tick_Reset_Stats();
+}
+
+/**
+ * Function Control_Tick_Start starts calling step_fn every control period, the first call one period from now.
+ * Statistics are not reset.
+ * @param step_fn [Control_Tick_Step_t] function to run on each tick
+ */
+void Control_Tick_Start( Control_Tick_Step_t step_fn )
+{
+    if( step_fn == NULL ){
+        Control_Tick_Stop();
+        return;
+    }
+
+    _max_pwm = Get_MAX_Motor_PWM();
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        _step_fn    = step_fn;
+        _tick_count = 0;
+        _step_index = 0;
+        _have_last  = false;
+        OCR3A       = TCNT3 + _step_length(0);
+
+        // Clear a stale compare flag, then enable the compare interrupt (Sec. 14.10.17 & 14.10.18)
+        TIFR3   = (1 << OCF3A);
+        TIMSK3 |= (1 << OCIE3A);
+        _running = true;
+    }
+}
+
+/**
+ * Function Control_Tick_Stop stops the tick. The PWM outputs are left as they are.
+ */
+void Control_Tick_Stop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        TIMSK3 &= ~(1 << OCIE3A);
+        _running = false;
+        _step_fn = NULL;
+    }
+}
+
+/**
+ * Function Control_Tick_Is_Running returns if the tick is running. It goes false after Control_Tick_Stop or once
+ * the step function returns false.
+ * @return [bool] true while ticking
+ */
+bool Control_Tick_Is_Running()
+{
+    return _running;
+}
+
+/**
+ * Function Control_Tick_Get_Stats copies out the per-tick timing statistics.
+ * @param p_stats [Control_Tick_Stats_t*] filled with the statistics
+ */
+void Control_Tick_Get_Stats( Control_Tick_Stats_t* p_stats )
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        *p_stats = _stats;
+    }
+}
+
+/**
+ * Function Control_Tick_Reset_Stats zeros the per-tick timing statistics.
+ */
+void Control_Tick_Reset_Stats()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        _stats.ticks       = 0;
+        _stats.overruns    = 0;
+        _stats.latency_max = 0;
+        _stats.exec_last   = 0;
+        _stats.exec_min    = 0xFFFF;
+        _stats.exec_max    = 0;
+    }
+}
+
+/**
+ * Interrupt service routine for the Timer3 compare. Every compare schedules the next one from its own compare
+ * value; the last compare step of a period runs the control tick. The tick body runs with interrupts enabled.
+ */
+ISR(TIMER3_COMPA_vect, ISR_NOBLOCK)
+{
+    uint16_t compare;
+    uint16_t start;
+    uint8_t  index = _step_index + 1;
+    if( index >= _steps ){
+        index = 0;
+    }
+    _step_index = index;
+
+    // Timer3's 16-bit registers share one TEMP register, keep nested interrupts out while using them
+    ATOMIC_BLOCK(ATOMIC_FORCEON){
+        compare = OCR3A;
+        start   = TCNT3;
+        OCR3A   = compare + _step_length(index);
+    }
+
+    if( index != 0 ){
+        return; // postscaler: not the end of a control period yet
+    }
+
+    if( _in_tick ){
+        _stats.overruns++; // previous tick still running, drop this one
+        return;
+    }
+    _in_tick = true;
+    uint16_t overruns = _stats.overruns;
+
+    Control_Tick_Step_t step_fn = _step_fn;
+    if( step_fn != NULL ){
+        Control_Tick_Sample_t sample;
+        sample.rad_left  = Rad_Left();
+        sample.rad_right = Rad_Right();
+        sample.period_us = _period_us;
+        sample.dt        = _dt;
+        sample.tick      = _tick_count++;
+
+        Control_Tick_Output_t output = { 0, 0 };
+        if( step_fn(&sample, &output) ){
+            _write_pwm(output.left, output.right);
+        }else{
+            _write_pwm(0, 0);
+            Control_Tick_Stop();
+        }
+    }
+
+    uint16_t exec    = _timer3_now() - start;
+    uint16_t latency = start - compare;
+
+    _stats.ticks++;
+    _stats.exec_last = exec;
+    if( exec < _stats.exec_min ){
+        _stats.exec_min = exec;
+    }
+    if( exec > _stats.exec_max ){
+        _stats.exec_max = exec;
+    }
+    if( latency > _stats.latency_max ){
+        _stats.latency_max = latency;
+    }
+
+    // Ticks are nominally one period apart, the difference in latency is the jitter
+    Loop_Stats_Record(LOOP_STATS_CONTROL_EXEC, exec / CONTROL_TICK_COUNTS_PER_US);
+    if( _have_last ){
+        int16_t jitter = (int16_t)(latency - _last_latency) / (int16_t) CONTROL_TICK_COUNTS_PER_US;
+        Loop_Stats_Record(LOOP_STATS_CONTROL_PERIOD, (int32_t) _period_us + jitter);
+    }
+    // A tick dropped while this one ran breaks the period measurement to the next tick
+    _last_latency = latency;
+    _have_last    = (_stats.overruns == overruns);
+
+    _in_tick = false;
+}
@@ -0,0 +1,135 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Control_Tick.h/c runs the wheel control loop from the Timer3 Output Compare A interrupt, so the controllers are
+ * stepped at an exact rate no matter what the main loop is doing (USB traffic, battery filtering, message handling).
+ *
+ * Timer3 free-runs at the CPU clock (62.5 ns per count at 16 MHz) and is never reset. Each compare moves OCR3A
+ * forward from the previous compare value rather than from "now", so ISR latency never accumulates into drift.
+ * A control period longer than the 16-bit timer range is split into equal compare steps and a software postscaler
+ * counts them (5 ms = 80000 counts = 2 steps of 40000). See Section 14 of the atmega32U4 datasheet.
+ *
+ * On every tick the ISR
+ *   1) samples both encoders,
+ *   2) calls the registered step function with the samples and the exact tick period, and
+ *   3) writes the signed PWM it returns (sign sets the direction pins PB2 left / PB1 right, magnitude is clamped to
+ *      Get_MAX_Motor_PWM()).
+ *
+ * The tick body runs with interrupts re-enabled (ISR_NOBLOCK) so USB, encoder and Timer0 interrupts are not held
+ * off by the controller math. A tick that is still running when the next one is due is not re-entered; the late
+ * tick is dropped and counted as an overrun.
+ *
+ * The step function runs in interrupt context: it must not touch the USB buffers or block. It returns false when
+ * the motion is finished, which zeros the PWM and stops the tick (see Control_Tick_Is_Running).
+ */
+#ifndef _CONTROL_TICK_H
+#define _CONTROL_TICK_H
+
+#include <avr/interrupt.h> // for ISR
+#include <avr/io.h>        // for Timer3 registers
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Encoder samples and timing handed to the step function on each tick.
+ */
+typedef struct {
+    float    rad_left;    // [rad] left encoder angle sampled at the start of the tick
+    float    rad_right;   // [rad] right encoder angle sampled at the start of the tick
+    uint16_t period_us;   // [us] exact time since the previous tick (the configured period)
+    float    dt;          // [s] period_us in seconds, for Controller_Update
+    uint32_t tick;        // number of ticks since Control_Tick_Start
+} Control_Tick_Sample_t;
+
+/**
+ * Signed PWM the step function asks for. Negative values drive the track backwards.
+ */
+typedef struct {
+    int16_t left;
+    int16_t right;
+} Control_Tick_Output_t;
+
+/**
+ * Step function run on every tick. Return true to keep running, false when the motion is finished.
+ */
+typedef bool (*Control_Tick_Step_t)( const Control_Tick_Sample_t* p_sample, Control_Tick_Output_t* p_output );
+
+/**
+ * Per-tick timing statistics, in Timer3 counts (CPU cycles). Latency is from the scheduled compare to the start of
+ * the tick body (the jitter of the encoder sample time); execution is the tick body itself.
+ */
+typedef struct __attribute__((__packed__)) {
+    uint32_t ticks;       // ticks run since the last reset
+    uint16_t overruns;    // ticks dropped because the previous tick was still running
+    uint16_t latency_max; // worst compare-to-start latency
+    uint16_t exec_last;   // execution time of the most recent tick
+    uint16_t exec_min;    // shortest execution time
+    uint16_t exec_max;    // longest execution time
+} Control_Tick_Stats_t;
+
+/**
+ * Function Control_Tick_Init starts Timer3 free-running at the CPU clock and sets the control period. The tick
+ * interrupt stays off until Control_Tick_Start.
+ * @param period_us [uint16_t] control period in microseconds (at least 100 us)
+ */
+void Control_Tick_Init( uint16_t period_us );
+
+/**
+ * Function Control_Tick_Start starts calling step_fn every control period, the first call one period from now.
+ * Statistics are not reset.
+ * @param step_fn [Control_Tick_Step_t] function to run on each tick
+ */
+void Control_Tick_Start( Control_Tick_Step_t step_fn );
+
+/**
+ * Function Control_Tick_Stop stops the tick. The PWM outputs are left as they are.
+ */
+void Control_Tick_Stop();
+
+/**
+ * Function Control_Tick_Is_Running returns if the tick is running. It goes false after Control_Tick_Stop or once
+ * the step function returns false.
+ * @return [bool] true while ticking
+ */
+bool Control_Tick_Is_Running();
+
+/**
+ * Function Control_Tick_Get_Stats copies out the per-tick timing statistics.
+ * @param p_stats [Control_Tick_Stats_t*] filled with the statistics
+ */
+void Control_Tick_Get_Stats( Control_Tick_Stats_t* p_stats );
+
+/**
+ * Function Control_Tick_Reset_Stats zeros the per-tick timing statistics.
+ */
+void Control_Tick_Reset_Stats();
+
+#endif
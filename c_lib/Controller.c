@@ -38,6 +38,7 @@
 
 #include "Controller.h"
 #include "Filter.h"
+#include "Profile.h"
 
 /**
  * Function Initialize_Controller setsup the z-transform based controller for the system.
@@ -76,6 +77,8 @@ void Controller_Set_Target_Position( Controller_t* p_cont, float vel )
  */
 float Controller_Update( Controller_t* p_cont, float measurement, float dt )
 {
+    PROFILE_BEGIN(PROFILE_CONTROLLER_UPDATE);
+
     float filter_val = Filter_Value(&p_cont->controller, measurement);
     float target;
     // Velocity update
@@ -87,6 +90,8 @@ float Controller_Update( Controller_t* p_cont, float measurement, float dt )
     } 
 
     float last_control_command = p_cont->kp * (target - filter_val);
+
+    PROFILE_END(PROFILE_CONTROLLER_UPDATE);
     return last_control_command;
 
     // float out_last = Controller_Last(&p_cont);
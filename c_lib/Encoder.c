@@ -1,4 +1,5 @@
 #include "Encoder.h"
+#include "Profile.h"
 
 /**
 * Internal counters for the Interrupts to increment or decrement as necessary.
@@ -163,6 +164,8 @@ float Rad_Right()
  */
 ISR(PCINT0_vect)
 {
+    PROFILE_BEGIN(PROFILE_ENCODER_LEFT_ISR);
+
     // Check to see if movement has happened on left side
     if(Left_XOR() != _last_left_A){
         // Get counts on left (see Lecture 14 class notes)
@@ -172,10 +175,9 @@ ISR(PCINT0_vect)
         _last_left_A   = Left_A();
         _last_left_B   = Left_B();
         _last_left_XOR = Left_XOR();
-
-        return;
     }
-    return;
+
+    PROFILE_END(PROFILE_ENCODER_LEFT_ISR);
 }
 
 
@@ -186,6 +188,8 @@ ISR(PCINT0_vect)
  */
 ISR(INT6_vect)
 {
+    PROFILE_BEGIN(PROFILE_ENCODER_RIGHT_ISR);
+
     // Check to see if movement has happened on right side
     if(Right_XOR() != _last_right_A){
         // Get counts on right (see Lecture 14 class notes)
@@ -195,8 +199,7 @@ ISR(INT6_vect)
         _last_right_A   = Right_A();
         _last_right_B   = Right_B();
         //_last_right_XOR = Right_XOR();
-        
-        return;
     }
-    return;
+
+    PROFILE_END(PROFILE_ENCODER_RIGHT_ISR);
 }
@@ -1,4 +1,62 @@
 #include "Filter.h"
+#include "Profile.h"
+
+// Lists within a filter's pool slot, each capacity+1 floats long
+#define FILTER_LIST_B   0
+#define FILTER_LIST_A   1
+#define FILTER_LIST_IN  2
+#define FILTER_LIST_OUT 3
+
+/**
+ * Function _filter_list returns the start of one of the filter's lists in its pool slot.
+ */
+static inline float* _filter_list( const Filter_Data_t* p_filt, uint8_t list )
+{
+    return p_filt->storage + list * (uint16_t)(p_filt->capacity + 1);
+}
+
+/**
+ * Function _filter_load zeros a pool slot holding the given number of channels and loads the coefficients divided by
+ * A_0, reading them from flash when in_flash is set. On a bad order or A_0 the slot is left as a pass-through
+ * (B_0 = 1) and false is returned.
+ */
+static bool _filter_load( float* storage, uint8_t capacity, uint8_t channels, const float* num, const float* den,
+                          uint8_t order, bool in_flash )
+{
+    float* b = storage;
+    float* a = storage + capacity + 1;
+    for(uint16_t i=0;i<FILTER_POOL_SLOT_FLOATS(capacity, channels);i++){
+        storage[i] = 0;
+    }
+    b[0] = 1;
+
+    if( order > capacity ) return false;
+
+    float a0 = in_flash ? pgm_read_float(&den[0]) : den[0];
+    if( a0 == 0 ) return false;
+
+    for(uint8_t i=0;i<=order;i++){
+        b[i] = (in_flash ? pgm_read_float(&num[i]) : num[i]) / a0;
+        a[i] = (i == 0) ? 0 : (in_flash ? pgm_read_float(&den[i]) : den[i]) / a0;
+    }
+
+    return true;
+}
+
+/**
+ * Function _filter_init binds the coefficients to a single channel filter, see Filter_Init.
+ */
+static bool _filter_init( Filter_Data_t* p_filt, const float* num, const float* den, uint8_t order, bool in_flash )
+{
+    p_filt->order = 0;
+    p_filt->head = 0;
+
+    if( p_filt->storage == NULL ) return false;
+    if( !_filter_load(p_filt->storage, p_filt->capacity, 1, num, den, order, in_flash) ) return false;
+
+    p_filt->order = order;
+    return true;
+}
 
 /**
  * Function Filter_Init initializes the filter given two float arrays and the order of the filter.  Note that the
@@ -8,30 +66,32 @@
  *         i=0..N                    i=1..N
  *
  *  Note a 5-point moving average filter has coefficients:
- *      numerator_coeffs   = { 5 0 0 0 0 };
- *      denominator_coeffs = { 1 1 1 1 1 };
+ *      numerator_coeffs (B's)   = { 1 1 1 1 1 };
+ *      denominator_coeffs (A's) = { 5 0 0 0 0 };
  *      order = 4;
  *
  * @param p_filt pointer to the filter object
  * @param numerator_coeffs The numerator coefficients (B/beta traditionally)
  * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
- * @param order The filter order
+ * @param order The filter order, at most the capacity of the filter's pool slot
+ * @return false if the filter is unbound, the order is too large or A_0 is 0 (the filter then passes its input through)
  */
-void  Filter_Init ( Filter_Data_t* p_filt, float* numerator_coeffs, float* denominator_coeffs, uint8_t order )
+bool Filter_Init( Filter_Data_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order )
 {
-    rb_initialize_F(&p_filt->numerator);
-    rb_initialize_F(&p_filt->denominator);
-    rb_initialize_F(&p_filt->out_list);
-    rb_initialize_F(&p_filt->in_list);
-
-    for(int i=0;i<order+1;i++){
-        rb_push_back_F(&p_filt->numerator,numerator_coeffs[i]);
-        rb_push_back_F(&p_filt->in_list,0);
-        rb_push_back_F(&p_filt->denominator,denominator_coeffs[i]);
-        rb_push_back_F(&p_filt->out_list,0);
-    }
+    return _filter_init(p_filt, numerator_coeffs, denominator_coeffs, order, false);
+}
 
-	return;
+/**
+ * Function Filter_Init_P is Filter_Init for coefficient tables declared const PROGMEM.
+ * @param p_filt pointer to the filter object
+ * @param numerator_coeffs_P The numerator coefficients, in program memory
+ * @param denominator_coeffs_P The denominator coefficients, in program memory
+ * @param order The filter order, at most the capacity of the filter's pool slot
+ * @return false if the filter is unbound, the order is too large or A_0 is 0 (the filter then passes its input through)
+ */
+bool Filter_Init_P( Filter_Data_t* p_filt, const float* numerator_coeffs_P, const float* denominator_coeffs_P, uint8_t order )
+{
+    return _filter_init(p_filt, numerator_coeffs_P, denominator_coeffs_P, order, true);
 }
 
 /**
@@ -42,12 +102,13 @@ void  Filter_Init ( Filter_Data_t* p_filt, float* numerator_coeffs, float* denom
  */
 void  Filter_ShiftBy( Filter_Data_t* p_filt, float shift_amount )
 {
-    for(int i=0;i<rb_length_F(&p_filt->in_list);i++){
-        float valN = rb_get_F(&p_filt->in_list,i);
-        float valD = rb_get_F(&p_filt->out_list,i);
+    if( p_filt->storage == NULL ) return;
 
-        rb_set_F(&p_filt->in_list,i,valN + shift_amount);
-        rb_set_F(&p_filt->out_list,i,valD + shift_amount);
+    float* x = _filter_list(p_filt, FILTER_LIST_IN);
+    float* y = _filter_list(p_filt, FILTER_LIST_OUT);
+    for(uint8_t i=0;i<=p_filt->order;i++){
+        x[i] += shift_amount;
+        y[i] += shift_amount;
     }
 
     return;
@@ -61,9 +122,13 @@ void  Filter_ShiftBy( Filter_Data_t* p_filt, float shift_amount )
  */
 void Filter_SetTo( Filter_Data_t* p_filt, float amount )
 {
-    for(int i=0;i<rb_length_F(&p_filt->in_list);i++){
-        rb_set_F(&p_filt->in_list,i,amount);
-        rb_set_F(&p_filt->out_list,i,amount);
+    if( p_filt->storage == NULL ) return;
+
+    float* x = _filter_list(p_filt, FILTER_LIST_IN);
+    float* y = _filter_list(p_filt, FILTER_LIST_OUT);
+    for(uint8_t i=0;i<=p_filt->order;i++){
+        x[i] = amount;
+        y[i] = amount;
     }
 
     return;
@@ -77,33 +142,33 @@ void Filter_SetTo( Filter_Data_t* p_filt, float amount )
  */
 float Filter_Value( Filter_Data_t* p_filt, float value)
 {
-    float first = 0;
-    float last = 0;
-    float fin = 0;
+    if( p_filt->storage == NULL ) return value;
 
-    float az = rb_get_F(&p_filt->denominator,0);
+    PROFILE_BEGIN(PROFILE_FILTER_VALUE);
 
-    rb_push_front_F(&p_filt->in_list,value);
-    rb_pop_back_F(&p_filt->in_list);
+    const uint8_t order = p_filt->order;
+    const float*  b     = _filter_list(p_filt, FILTER_LIST_B);
+    const float*  a     = _filter_list(p_filt, FILTER_LIST_A);
+    float*        x     = _filter_list(p_filt, FILTER_LIST_IN);
+    float*        y     = _filter_list(p_filt, FILTER_LIST_OUT);
 
-    for(int i=0;i<rb_length_F(&p_filt->numerator);i++){
-        float bn = rb_get_F(&p_filt->numerator,i);
-        float in = rb_get_F(&p_filt->in_list,i);
-        first += (bn*in);
-    }
+    // Step the write index back one; the slot it lands on holds the oldest sample, which the new one replaces
+    uint8_t head = (p_filt->head == 0) ? order : p_filt->head - 1;
+    x[head] = value;
 
-    for(int i=1;i<rb_length_F(&p_filt->denominator);i++){
-        float an = rb_get_F(&p_filt->denominator,i);
-        float out = rb_get_F(&p_filt->out_list,i-1);
-        last += (an*out);
+    // Both delay lines hold sample n-i at head+i (wrapping), the outputs because y[head] is still the oldest one
+    float   sum = b[0] * value;
+    uint8_t j   = head;
+    for(uint8_t i=1;i<=order;i++){
+        if( ++j > order ) j = 0;
+        sum += b[i] * x[j] - a[i] * y[j];
     }
 
-    fin = (1/az)*(first-last);
-
-    rb_push_front_F(&p_filt->out_list,fin);
-    rb_pop_back_F(&p_filt->out_list);
+    y[head] = sum;
+    p_filt->head = head;
 
-	return fin;
+    PROFILE_END(PROFILE_FILTER_VALUE);
+	return sum;
 }
 
 /**
@@ -112,5 +177,436 @@ float Filter_Value( Filter_Data_t* p_filt, float value)
  */
 float Filter_Last_Output( Filter_Data_t* p_filt )
 {
-	return rb_get_F(&p_filt->out_list,0);
-}
\ No newline at end of file
+    if( p_filt->storage == NULL ) return 0;
+
+	return _filter_list(p_filt, FILTER_LIST_OUT)[p_filt->head];
+}
+
+/****** Second-order-section (biquad) cascade **********/
+
+/**
+ * Function _sos_dc_gain returns section k's gain for a constant input, (B_0+B_1+B_2)/(1+A_1+A_2).
+ */
+static float _sos_dc_gain( const Filter_SOS_t* p_filt, uint8_t k )
+{
+    float den = 1 + p_filt->coeffs[k][3] + p_filt->coeffs[k][4];
+    return (den == 0) ? 0 : (p_filt->coeffs[k][0] + p_filt->coeffs[k][1] + p_filt->coeffs[k][2]) / den;
+}
+
+/**
+ * Function Filter_SOS_Init loads the section coefficients and zeros the filter.
+ * @param p_filt pointer to the filter object
+ * @param sos_coeffs rows of { B_0, B_1, B_2, A_0, A_1, A_2 }, one per section, applied in order
+ * @param sections number of rows, at most FILTER_SOS_MAX_SECTIONS
+ * @return false if there are too many sections or an A_0 is 0 (the filter then passes its input through)
+ */
+bool Filter_SOS_Init( Filter_SOS_t* p_filt, const float sos_coeffs[][6], uint8_t sections )
+{
+    p_filt->sections = 0;
+    p_filt->last_output = 0;
+
+    if( sections > FILTER_SOS_MAX_SECTIONS ) return false;
+
+    for(uint8_t k=0;k<sections;k++){
+        float a0 = sos_coeffs[k][3];
+        if( a0 == 0 ) return false;
+
+        p_filt->coeffs[k][0] = sos_coeffs[k][0] / a0;
+        p_filt->coeffs[k][1] = sos_coeffs[k][1] / a0;
+        p_filt->coeffs[k][2] = sos_coeffs[k][2] / a0;
+        p_filt->coeffs[k][3] = sos_coeffs[k][4] / a0;
+        p_filt->coeffs[k][4] = sos_coeffs[k][5] / a0;
+        p_filt->state[k][0] = 0;
+        p_filt->state[k][1] = 0;
+    }
+    p_filt->sections = sections;
+
+    return true;
+}
+
+/**
+ * Function Filter_SOS_ShiftBy moves the filter's history by a constant input step, as Filter_ShiftBy: every past
+ * input is treated as shift_amount larger and every past output as shifted by the filter's DC gain times that.
+ * @param p_filt pointer to the filter object
+ * @param shift_amount amount the input history moves by
+ */
+void Filter_SOS_ShiftBy( Filter_SOS_t* p_filt, float shift_amount )
+{
+    float d_in = shift_amount;
+
+    for(uint8_t k=0;k<p_filt->sections;k++){
+        float d_out = d_in * _sos_dc_gain(p_filt, k);
+
+        // The delays hold B_i*x - A_i*y terms, so they move by the same combination of the shifts
+        float d_s2 = p_filt->coeffs[k][2]*d_in - p_filt->coeffs[k][4]*d_out;
+        p_filt->state[k][1] += d_s2;
+        p_filt->state[k][0] += p_filt->coeffs[k][1]*d_in - p_filt->coeffs[k][3]*d_out + d_s2;
+
+        d_in = d_out;
+    }
+    p_filt->last_output += d_in;
+}
+
+/**
+ * Function Filter_SOS_SetTo puts the filter in steady state for a constant input, as Filter_SetTo.
+ * @param p_filt pointer to the filter object
+ * @param amount the constant input (a unity DC gain filter then outputs it too)
+ */
+void Filter_SOS_SetTo( Filter_SOS_t* p_filt, float amount )
+{
+    float x = amount;
+
+    for(uint8_t k=0;k<p_filt->sections;k++){
+        float y = x * _sos_dc_gain(p_filt, k);
+
+        p_filt->state[k][1] = p_filt->coeffs[k][2]*x - p_filt->coeffs[k][4]*y;
+        p_filt->state[k][0] = p_filt->coeffs[k][1]*x - p_filt->coeffs[k][3]*y + p_filt->state[k][1];
+
+        x = y;
+    }
+    p_filt->last_output = x;
+}
+
+/**
+ * Function Filter_SOS_Value adds a new value to the filter and returns the new output.
+ * @param p_filt pointer to the filter object
+ * @param value the new measurement or value
+ * @return The newly filtered value
+ */
+float Filter_SOS_Value( Filter_SOS_t* p_filt, float value )
+{
+    PROFILE_BEGIN(PROFILE_FILTER_SOS_VALUE);
+
+    float x = value;
+
+    for(uint8_t k=0;k<p_filt->sections;k++){
+        // Transposed direct form II (indexed rather than through row pointers, the struct is packed)
+        float y = p_filt->coeffs[k][0]*x + p_filt->state[k][0];
+        p_filt->state[k][0] = p_filt->coeffs[k][1]*x - p_filt->coeffs[k][3]*y + p_filt->state[k][1];
+        p_filt->state[k][1] = p_filt->coeffs[k][2]*x - p_filt->coeffs[k][4]*y;
+
+        x = y;
+    }
+    p_filt->last_output = x;
+
+    PROFILE_END(PROFILE_FILTER_SOS_VALUE);
+    return x;
+}
+
+/**
+ * Function Filter_SOS_Last_Output returns the most up-to-date filtered value without updating the filter.
+ * @return The latest filtered value
+ */
+float Filter_SOS_Last_Output( const Filter_SOS_t* p_filt )
+{
+    return p_filt->last_output;
+}
+
+/****** Fixed-point filter **********/
+
+/**
+ * Function _q31_mac adds a*b to a 32-bit accumulator, saturating at the int32_t limits instead of wrapping.
+ */
+static inline int32_t _q31_mac( int32_t acc, int16_t a, int16_t b )
+{
+    int32_t product = (int32_t) a * b;
+    int32_t sum     = (int32_t) ((uint32_t) acc + (uint32_t) product);
+
+    // Overflow only if both operands have the same sign and the sum's sign differs
+    if( ((acc ^ sum) & (product ^ sum)) < 0 ){
+        sum = (acc < 0) ? INT32_MIN : INT32_MAX;
+    }
+    return sum;
+}
+
+/**
+ * Function _sat16 clamps a 32-bit value to the int16_t range.
+ */
+static inline int16_t _sat16( int32_t value )
+{
+    if( value > INT16_MAX ) return INT16_MAX;
+    if( value < INT16_MIN ) return INT16_MIN;
+    return value;
+}
+
+/**
+ * Function Filter_Fixed_Init quantizes the float coefficients (same layout and order as Filter_Init) and zeros the
+ * filter.
+ * @param p_filt pointer to the filter object
+ * @param numerator_coeffs The numerator coefficients (B/beta traditionally)
+ * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
+ * @param order The filter order, at most FILTER_FIXED_MAX_ORDER
+ * @return false if the order is too large, A_0 is 0, or a coefficient is too big to quantize (the filter then
+ *         passes its input through)
+ */
+bool Filter_Fixed_Init( Filter_Fixed_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order )
+{
+    for(uint8_t i=0;i<=FILTER_FIXED_MAX_ORDER;i++){
+        p_filt->numerator[i]   = 0;
+        p_filt->denominator[i] = 0;
+        p_filt->in_list[i]     = 0;
+        p_filt->out_list[i]    = 0;
+    }
+
+    // Pass-through (1.0 in Q14) until the coefficients are known to be usable
+    p_filt->order = 0;
+    p_filt->shift = 1;
+    p_filt->numerator[0] = 1 << 14;
+
+    if( order > FILTER_FIXED_MAX_ORDER || denominator_coeffs[0] == 0 ) return false;
+
+    // Normalize by A_0 and find the largest magnitude to pick the scale-down
+    float a0 = denominator_coeffs[0];
+    float largest = 0;
+    for(uint8_t i=0;i<=order;i++){
+        float b = numerator_coeffs[i] / a0;
+        float a = denominator_coeffs[i] / a0;
+        if( i > 0 && (a < 0 ? -a : a) > largest ) largest = (a < 0 ? -a : a);
+        if( (b < 0 ? -b : b) > largest ) largest = (b < 0 ? -b : b);
+    }
+
+    uint8_t shift = 0;
+    while( largest * (float)(1UL << (15 - shift)) > 32767.0f ){
+        if( ++shift > 15 ) return false;
+    }
+
+    // Quantize, rounding to nearest. The A's are stored negated so Filter_Fixed_Value only ever adds.
+    float scale = (float)(1UL << (15 - shift));
+    for(uint8_t i=0;i<=order;i++){
+        float b =  numerator_coeffs[i] / a0 * scale;
+        float a = -denominator_coeffs[i] / a0 * scale;
+        p_filt->numerator[i]   = (int16_t)(b + (b < 0 ? -0.5f : 0.5f));
+        p_filt->denominator[i] = (i == 0) ? 0 : (int16_t)(a + (a < 0 ? -0.5f : 0.5f));
+    }
+    p_filt->order = order;
+    p_filt->shift = shift;
+
+    return true;
+}
+
+/**
+ * Function Filter_Fixed_ShiftBy shifts the input list and output list by a constant (saturating), as Filter_ShiftBy.
+ * @param p_filt pointer to the filter object
+ * @param shift_amount amount to add to every stored input and output
+ */
+void Filter_Fixed_ShiftBy( Filter_Fixed_t* p_filt, int16_t shift_amount )
+{
+    for(uint8_t i=0;i<=p_filt->order;i++){
+        p_filt->in_list[i]  = _sat16((int32_t) p_filt->in_list[i]  + shift_amount);
+        p_filt->out_list[i] = _sat16((int32_t) p_filt->out_list[i] + shift_amount);
+    }
+}
+
+/**
+ * Function Filter_Fixed_SetTo sets every stored input and output to a constant, as Filter_SetTo.
+ * @param p_filt pointer to the filter object
+ * @param amount The value to re-initialize the filter to.
+ */
+void Filter_Fixed_SetTo( Filter_Fixed_t* p_filt, int16_t amount )
+{
+    for(uint8_t i=0;i<=p_filt->order;i++){
+        p_filt->in_list[i]  = amount;
+        p_filt->out_list[i] = amount;
+    }
+}
+
+/**
+ * Function Filter_Fixed_Value adds a new value to the filter and returns the new output.
+ * @param p_filt pointer to the filter object
+ * @param value the new measurement or value
+ * @return The newly filtered value
+ */
+int16_t Filter_Fixed_Value( Filter_Fixed_t* p_filt, int16_t value )
+{
+    PROFILE_BEGIN(PROFILE_FILTER_FIXED_VALUE);
+
+    uint8_t order = p_filt->order;
+
+    for(uint8_t i=order;i>0;i--){
+        p_filt->in_list[i] = p_filt->in_list[i-1];
+    }
+    p_filt->in_list[0] = value;
+
+    // SUM( B_i * input_i ) - SUM( A_i * output_i ), the A's are stored negated
+    int32_t acc = 0;
+    for(uint8_t i=0;i<=order;i++){
+        acc = _q31_mac(acc, p_filt->numerator[i], p_filt->in_list[i]);
+    }
+    for(uint8_t i=1;i<=order;i++){
+        acc = _q31_mac(acc, p_filt->denominator[i], p_filt->out_list[i-1]);
+    }
+
+    // Back from Q(15-shift) to the signal, rounding to nearest
+    uint8_t frac_bits = 15 - p_filt->shift;
+    if( frac_bits > 0 ){
+        int32_t half = (int32_t) 1 << (frac_bits - 1);
+        acc = (acc > INT32_MAX - half) ? INT32_MAX : acc + half;
+        acc >>= frac_bits;
+    }
+    int16_t fin = _sat16(acc);
+
+    for(uint8_t i=order;i>0;i--){
+        p_filt->out_list[i] = p_filt->out_list[i-1];
+    }
+    p_filt->out_list[0] = fin;
+
+    PROFILE_END(PROFILE_FILTER_FIXED_VALUE);
+    return fin;
+}
+
+/**
+ * Function Filter_Fixed_Last_Output returns the most up-to-date filtered value without updating the filter.
+ * @return The latest filtered value
+ */
+int16_t Filter_Fixed_Last_Output( const Filter_Fixed_t* p_filt )
+{
+    return p_filt->out_list[0];
+}
+
+/****** Multi-channel filter **********/
+
+/**
+ * Function _filter_multi_list returns the start of one of the filter's lists in its pool slot. The coefficient lists
+ * are capacity+1 floats, the history lists (capacity+1)*channels.
+ */
+static inline float* _filter_multi_list( const Filter_Multi_t* p_filt, uint8_t list )
+{
+    uint16_t stride = p_filt->capacity + 1;
+    switch(list){
+        case FILTER_LIST_B:  return p_filt->storage;
+        case FILTER_LIST_A:  return p_filt->storage + stride;
+        case FILTER_LIST_IN: return p_filt->storage + 2*stride;
+        default:             return p_filt->storage + 2*stride + stride*p_filt->channels;
+    }
+}
+
+/**
+ * Function Filter_Multi_Init loads one coefficient set for all of the filter's channels and zeros every channel.
+ * @param p_filt pointer to the filter object
+ * @param numerator_coeffs The numerator coefficients (B/beta traditionally)
+ * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
+ * @param order The filter order, at most the capacity of the filter's pool slot
+ * @return false if the filter is unbound, the order is too large or A_0 is 0 (every channel then passes through)
+ */
+bool Filter_Multi_Init( Filter_Multi_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order )
+{
+    p_filt->order = 0;
+    p_filt->head = 0;
+
+    if( p_filt->storage == NULL ) return false;
+    if( !_filter_load(p_filt->storage, p_filt->capacity, p_filt->channels, numerator_coeffs, denominator_coeffs,
+                      order, false) ) return false;
+
+    p_filt->order = order;
+    return true;
+}
+
+/**
+ * Function Filter_Multi_ShiftBy shifts each channel's input and output lists by that channel's amount, as
+ * Filter_ShiftBy.
+ * @param p_filt pointer to the filter object
+ * @param shift_amounts one amount per channel
+ */
+void Filter_Multi_ShiftBy( Filter_Multi_t* p_filt, const float* shift_amounts )
+{
+    if( p_filt->storage == NULL ) return;
+
+    const uint8_t n = p_filt->channels;
+    float* x = _filter_multi_list(p_filt, FILTER_LIST_IN);
+    float* y = _filter_multi_list(p_filt, FILTER_LIST_OUT);
+    for(uint8_t i=0;i<=p_filt->order;i++){
+        for(uint8_t c=0;c<n;c++){
+            x[i*n + c] += shift_amounts[c];
+            y[i*n + c] += shift_amounts[c];
+        }
+    }
+}
+
+/**
+ * Function Filter_Multi_SetTo sets each channel's input and output lists to that channel's amount, as Filter_SetTo.
+ * @param p_filt pointer to the filter object
+ * @param amounts one value per channel
+ */
+void Filter_Multi_SetTo( Filter_Multi_t* p_filt, const float* amounts )
+{
+    if( p_filt->storage == NULL ) return;
+
+    const uint8_t n = p_filt->channels;
+    float* x = _filter_multi_list(p_filt, FILTER_LIST_IN);
+    float* y = _filter_multi_list(p_filt, FILTER_LIST_OUT);
+    for(uint8_t i=0;i<=p_filt->order;i++){
+        for(uint8_t c=0;c<n;c++){
+            x[i*n + c] = amounts[c];
+            y[i*n + c] = amounts[c];
+        }
+    }
+}
+
+/**
+ * Function Filter_Value_N adds a new value to every channel and writes out the new outputs. The channels step
+ * together, so each coefficient is loaded once per tap and applied across all channels.
+ * @param p_filt pointer to the filter object
+ * @param in one new value per channel
+ * @param out one filtered value per channel (may be the same array as in)
+ */
+void Filter_Value_N( Filter_Multi_t* p_filt, const float* in, float* out )
+{
+    const uint8_t n = p_filt->channels;
+
+    if( p_filt->storage == NULL ){
+        for(uint8_t c=0;c<n;c++) out[c] = in[c];
+        return;
+    }
+
+    PROFILE_BEGIN(PROFILE_FILTER_MULTI_VALUE);
+
+    const uint8_t order = p_filt->order;
+    const float*  b     = _filter_multi_list(p_filt, FILTER_LIST_B);
+    const float*  a     = _filter_multi_list(p_filt, FILTER_LIST_A);
+    float*        x     = _filter_multi_list(p_filt, FILTER_LIST_IN);
+    float*        y     = _filter_multi_list(p_filt, FILTER_LIST_OUT);
+
+    // Same circular delay lines as Filter_Value, with the channels of one sample side by side
+    uint8_t head = (p_filt->head == 0) ? order : p_filt->head - 1;
+    float*  x_head = x + head*n;
+    for(uint8_t c=0;c<n;c++){
+        x_head[c] = in[c];
+        out[c] = b[0] * in[c];
+    }
+
+    uint8_t j = head;
+    for(uint8_t i=1;i<=order;i++){
+        if( ++j > order ) j = 0;
+        const float  b_i = b[i];
+        const float  a_i = a[i];
+        const float* x_j = x + j*n;
+        const float* y_j = y + j*n;
+        for(uint8_t c=0;c<n;c++){
+            out[c] += b_i * x_j[c] - a_i * y_j[c];
+        }
+    }
+
+    float* y_head = y + head*n;
+    for(uint8_t c=0;c<n;c++){
+        y_head[c] = out[c];
+    }
+    p_filt->head = head;
+
+    PROFILE_END(PROFILE_FILTER_MULTI_VALUE);
+}
+
+/**
+ * Function Filter_Multi_Last_Output copies out every channel's most up-to-date filtered value without updating the
+ * filter.
+ * @param p_filt pointer to the filter object
+ * @param out one value per channel
+ */
+void Filter_Multi_Last_Output( const Filter_Multi_t* p_filt, float* out )
+{
+    const uint8_t n = p_filt->channels;
+    const float*  y = (p_filt->storage == NULL) ? NULL : _filter_multi_list(p_filt, FILTER_LIST_OUT) + p_filt->head*n;
+
+    for(uint8_t c=0;c<n;c++){
+        out[c] = (y == NULL) ? 0 : y[c];
+    }
+}
@@ -27,16 +27,84 @@
 /**
  * Filter.h/c defines the functions necessary to implement a z-transform
  * filter for use both with digital filtering and control. 
- * 
- * This code leverages the Ring_Buffer code developed in the homework. 
  *
  */
 #ifndef _MEGN540_FILTER_H
 #define _MEGN540_FILTER_H
 
-#include "Ring_Buffer.h"
+#include <avr/pgmspace.h> // for the PROGMEM coefficient tables
+#include <stdbool.h> // for bool type
+#include <stddef.h>  // for NULL
+#include <stdint.h>  // for int16_t type
 
-typedef struct { struct Ring_Buffer_F numerator; struct Ring_Buffer_F denominator; struct Ring_Buffer_F out_list; struct Ring_Buffer_F in_list; } Filter_Data_t;
+/**
+ * Filter storage pool. Every Filter_Data_t takes its coefficients and history from a slot in one static float pool,
+ * so each filter costs what its order needs (4*(order+1) floats for one channel) and the order is no longer tied to
+ * RB_LENGTH_F. The slots are laid out at build time from FILTER_POOL_SLOT_LIST, one X(slot name, max order, channels)
+ * per filter; channels above 1 are for a Filter_Multi_t.
+ *
+ * The pool belongs to the application, so each lab only reserves the filters it binds. A lab defines its slot list
+ * before including any c_lib header and defines the pool once at file scope:
+ *      #define FILTER_POOL_SLOT_LIST(X) X(FILTER_SLOT_VOLTAGE, 4, 1)
+ *      ...
+ *      FILTER_POOL_DEFINE();
+ * The pool is sized to the slots unless FILTER_POOL_FLOATS is given, in which case the build fails on a static assert
+ * if the slots need more than that.
+ */
+#ifndef FILTER_POOL_SLOT_LIST
+#define FILTER_POOL_SLOT_LIST(X)
+#endif
+
+// Coefficients (B's and A's) once, plus input and output histories per channel
+#define FILTER_POOL_SLOT_FLOATS(ORDER, CHANNELS) ( 2 * ((ORDER) + 1) * (1 + (CHANNELS)) )
+
+// Each slot's first float, max order and channels, laid end to end; FILTER_POOL_USED is the total
+enum {
+#define X(NAME, ORDER, CHANNELS) NAME##_OFFSET, NAME##_END = NAME##_OFFSET + FILTER_POOL_SLOT_FLOATS(ORDER, CHANNELS) - 1,
+    FILTER_POOL_SLOT_LIST(X)
+#undef X
+    FILTER_POOL_USED
+};
+
+#ifndef FILTER_POOL_FLOATS
+#define FILTER_POOL_FLOATS FILTER_POOL_USED
+#endif
+
+enum {
+#define X(NAME, ORDER, CHANNELS) NAME##_ORDER = (ORDER), NAME##_CHANNELS = (CHANNELS),
+    FILTER_POOL_SLOT_LIST(X)
+#undef X
+    FILTER_POOL_MAX_ORDER = 254 // so the order loops' uint8_t counters cannot wrap
+};
+
+_Static_assert( FILTER_POOL_USED <= FILTER_POOL_FLOATS, "Filter slots overflow the pool, raise FILTER_POOL_FLOATS" );
+#define X(NAME, ORDER, CHANNELS) _Static_assert( (ORDER) <= FILTER_POOL_MAX_ORDER && (CHANNELS) >= 1 && (CHANNELS) < 256, \
+                                                 #NAME " order or channel count is out of range" );
+FILTER_POOL_SLOT_LIST(X)
+#undef X
+
+extern float Filter_Pool[];
+#define FILTER_POOL_DEFINE() float Filter_Pool[FILTER_POOL_FLOATS]
+
+/**
+ * Filter_Data_t runs a direct-form filter out of its pool slot: B_i/A_0, then A_i/A_0, then the input and output
+ * histories, each capacity+1 floats. The coefficients are divided by A_0 once at init and not touched again. The
+ * histories are circular delay lines that share one write index, head: the newest sample sits at head and older ones
+ * follow it upward, wrapping at order. A new sample overwrites the oldest one in place, so nothing is copied per
+ * sample.
+ *
+ * A filter is bound to its slot where it is declared, e.g.
+ *      static Filter_Data_t voltage_Filter = FILTER_POOL_BIND(FILTER_SLOT_VOLTAGE);
+ * Each slot should be bound to only one filter. An unbound filter passes its input through.
+ */
+typedef struct {
+    float*  storage;  // start of the pool slot, NULL if unbound
+    uint8_t capacity; // max order the slot holds
+    uint8_t order;
+    uint8_t head;
+} Filter_Data_t;
+
+#define FILTER_POOL_BIND(SLOT) { .storage = &Filter_Pool[SLOT##_OFFSET], .capacity = SLOT##_ORDER, .order = 0, .head = 0 }
 
 /**
  * Function Filter_Init initializes the filter given two float arrays and the order of the filter.  Note that the
@@ -53,9 +121,21 @@ typedef struct { struct Ring_Buffer_F numerator; struct Ring_Buffer_F denominato
  * @param p_filt pointer to the filter object
  * @param numerator_coeffs The numerator coefficients (B/beta traditionally)
  * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
- * @param order The filter order
+ * @param order The filter order, at most the capacity of the filter's pool slot
+ * @return false if the filter is unbound, the order is too large or A_0 is 0 (the filter then passes its input through)
  */
-void  Filter_Init ( Filter_Data_t* p_filt, float* numerator_coeffs, float* denominator_coeffs, uint8_t order );
+bool  Filter_Init ( Filter_Data_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order );
+
+/**
+ * Function Filter_Init_P is Filter_Init for coefficient tables declared const PROGMEM, so the tables live only in
+ * flash instead of also being copied into SRAM at startup.
+ * @param p_filt pointer to the filter object
+ * @param numerator_coeffs_P The numerator coefficients, in program memory
+ * @param denominator_coeffs_P The denominator coefficients, in program memory
+ * @param order The filter order, at most the capacity of the filter's pool slot
+ * @return false if the filter is unbound, the order is too large or A_0 is 0 (the filter then passes its input through)
+ */
+bool  Filter_Init_P ( Filter_Data_t* p_filt, const float* numerator_coeffs_P, const float* denominator_coeffs_P, uint8_t order );
 
 /**
  * Function Filter_ShiftBy shifts the input list and output list to keep the filter in the same frame. This especially
@@ -87,5 +167,186 @@ float Filter_Value( Filter_Data_t* p_filt, float value);
  */
 float Filter_Last_Output(  Filter_Data_t* p_filt );
 
+/****** Second-order-section (biquad) cascade **********/
+
+/**
+ * Filter_SOS_t runs a filter as a cascade of second order sections (biquads) in transposed direct form II. Factoring
+ * a high order filter into sections keeps each section's poles well conditioned, where the expanded direct-form
+ * polynomial (e.g. the 4th order battery Butterworth, whose A's nearly cancel) loses precision. Each section costs
+ * 5 multiply-adds per sample and keeps 2 state values; the coefficients and states are plain contiguous arrays.
+ *
+ * Sections are given as rows of { B_0, B_1, B_2, A_0, A_1, A_2 } (the layout of Matlab's tf2sos and scipy's sos
+ * output) and are normalized by A_0 at init.
+ */
+#define FILTER_SOS_MAX_SECTIONS 4
+
+typedef struct {
+    float coeffs[FILTER_SOS_MAX_SECTIONS][5];  // per section B_0 B_1 B_2 A_1 A_2, divided by A_0
+    float state[FILTER_SOS_MAX_SECTIONS][2];   // per section transposed direct form II delays
+    float last_output;
+    uint8_t sections;
+} Filter_SOS_t;
+
+/**
+ * Function Filter_SOS_Init loads the section coefficients and zeros the filter.
+ * @param p_filt pointer to the filter object
+ * @param sos_coeffs rows of { B_0, B_1, B_2, A_0, A_1, A_2 }, one per section, applied in order
+ * @param sections number of rows, at most FILTER_SOS_MAX_SECTIONS
+ * @return false if there are too many sections or an A_0 is 0 (the filter then passes its input through)
+ */
+bool  Filter_SOS_Init ( Filter_SOS_t* p_filt, const float sos_coeffs[][6], uint8_t sections );
+
+/**
+ * Function Filter_SOS_ShiftBy moves the filter's history by a constant input step, as Filter_ShiftBy: every past
+ * input is treated as shift_amount larger and every past output as shifted by the filter's DC gain times that.
+ * @param p_filt pointer to the filter object
+ * @param shift_amount amount the input history moves by
+ */
+void  Filter_SOS_ShiftBy( Filter_SOS_t* p_filt, float shift_amount );
+
+/**
+ * Function Filter_SOS_SetTo puts the filter in steady state for a constant input, as Filter_SetTo.
+ * @param p_filt pointer to the filter object
+ * @param amount the constant input (a unity DC gain filter then outputs it too)
+ */
+void  Filter_SOS_SetTo( Filter_SOS_t* p_filt, float amount );
+
+/**
+ * Function Filter_SOS_Value adds a new value to the filter and returns the new output.
+ * @param p_filt pointer to the filter object
+ * @param value the new measurement or value
+ * @return The newly filtered value
+ */
+float Filter_SOS_Value( Filter_SOS_t* p_filt, float value );
+
+/**
+ * Function Filter_SOS_Last_Output returns the most up-to-date filtered value without updating the filter.
+ * @return The latest filtered value
+ */
+float Filter_SOS_Last_Output( const Filter_SOS_t* p_filt );
+
+/****** Fixed-point filter **********/
+
+/**
+ * Filter_Fixed_t is the same direct-form filter in integer arithmetic, for the FPU-less AVR. Inputs and outputs are
+ * int16_t (e.g. ADC counts shifted up to use the range). The coefficients are divided by A_0 and quantized to Q15
+ * once, at init. Coefficients of 1 or more (common in the A's) are scaled down by 2^shift first, and the sum is
+ * scaled back up by the same amount. Products are summed in a saturating 32-bit accumulator and the output
+ * saturates at the int16_t limits, so overflow clips instead of wrapping.
+ *
+ * Quantizing to 15-shift bits moves the poles slightly; check narrow, high order filters before relying on them.
+ */
+#define FILTER_FIXED_MAX_ORDER 4
+
+typedef struct {
+    int16_t numerator[FILTER_FIXED_MAX_ORDER+1];   // B_i/A_0 in Q(15-shift)
+    int16_t denominator[FILTER_FIXED_MAX_ORDER+1]; // A_i/A_0 in Q(15-shift), [0] unused
+    int16_t in_list[FILTER_FIXED_MAX_ORDER+1];     // newest input first
+    int16_t out_list[FILTER_FIXED_MAX_ORDER+1];    // newest output first
+    uint8_t order;
+    uint8_t shift;                                 // coefficient scale-down, 0 when every |coefficient| < 1
+} Filter_Fixed_t;
+
+/**
+ * Function Filter_Fixed_Init quantizes the float coefficients (same layout and order as Filter_Init) and zeros the
+ * filter.
+ * @param p_filt pointer to the filter object
+ * @param numerator_coeffs The numerator coefficients (B/beta traditionally)
+ * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
+ * @param order The filter order, at most FILTER_FIXED_MAX_ORDER
+ * @return false if the order is too large, A_0 is 0, or a coefficient is too big to quantize (the filter then
+ *         passes its input through)
+ */
+bool  Filter_Fixed_Init ( Filter_Fixed_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order );
+
+/**
+ * Function Filter_Fixed_ShiftBy shifts the input list and output list by a constant (saturating), as Filter_ShiftBy.
+ * @param p_filt pointer to the filter object
+ * @param shift_amount amount to add to every stored input and output
+ */
+void  Filter_Fixed_ShiftBy( Filter_Fixed_t* p_filt, int16_t shift_amount );
+
+/**
+ * Function Filter_Fixed_SetTo sets every stored input and output to a constant, as Filter_SetTo.
+ * @param p_filt pointer to the filter object
+ * @param amount The value to re-initialize the filter to.
+ */
+void  Filter_Fixed_SetTo( Filter_Fixed_t* p_filt, int16_t amount );
+
+/**
+ * Function Filter_Fixed_Value adds a new value to the filter and returns the new output.
+ * @param p_filt pointer to the filter object
+ * @param value the new measurement or value
+ * @return The newly filtered value
+ */
+int16_t Filter_Fixed_Value( Filter_Fixed_t* p_filt, int16_t value );
+
+/**
+ * Function Filter_Fixed_Last_Output returns the most up-to-date filtered value without updating the filter.
+ * @return The latest filtered value
+ */
+int16_t Filter_Fixed_Last_Output( const Filter_Fixed_t* p_filt );
+
+/****** Multi-channel filter **********/
+
+/**
+ * Filter_Multi_t runs one coefficient set over several channels that step together, e.g. left and right tracks with
+ * the same dynamics. The histories are stored structure-of-arrays: each delay slot holds that sample for every channel
+ * side by side, so Filter_Value_N loads each coefficient once and applies it across the channels. Storage comes from
+ * a pool slot with CHANNELS above 1, bound at declaration:
+ *      static Filter_Multi_t track_Filter = FILTER_MULTI_POOL_BIND(FILTER_SLOT_TRACKS);
+ */
+typedef struct {
+    float*  storage;  // start of the pool slot, NULL if unbound
+    uint8_t capacity; // max order the slot holds
+    uint8_t channels;
+    uint8_t order;
+    uint8_t head;
+} Filter_Multi_t;
+
+#define FILTER_MULTI_POOL_BIND(SLOT) { .storage = &Filter_Pool[SLOT##_OFFSET], .capacity = SLOT##_ORDER, \
+                                       .channels = SLOT##_CHANNELS, .order = 0, .head = 0 }
+
+/**
+ * Function Filter_Multi_Init loads one coefficient set for all of the filter's channels and zeros every channel.
+ * Coefficients are as Filter_Init.
+ * @param p_filt pointer to the filter object
+ * @param numerator_coeffs The numerator coefficients (B/beta traditionally)
+ * @param denominator_coeffs The denominator coefficients (A/alpha traditionally)
+ * @param order The filter order, at most the capacity of the filter's pool slot
+ * @return false if the filter is unbound, the order is too large or A_0 is 0 (every channel then passes through)
+ */
+bool  Filter_Multi_Init ( Filter_Multi_t* p_filt, const float* numerator_coeffs, const float* denominator_coeffs, uint8_t order );
+
+/**
+ * Function Filter_Multi_ShiftBy shifts each channel's input and output lists by that channel's amount, as
+ * Filter_ShiftBy.
+ * @param p_filt pointer to the filter object
+ * @param shift_amounts one amount per channel
+ */
+void  Filter_Multi_ShiftBy( Filter_Multi_t* p_filt, const float* shift_amounts );
+
+/**
+ * Function Filter_Multi_SetTo sets each channel's input and output lists to that channel's amount, as Filter_SetTo.
+ * @param p_filt pointer to the filter object
+ * @param amounts one value per channel
+ */
+void  Filter_Multi_SetTo( Filter_Multi_t* p_filt, const float* amounts );
+
+/**
+ * Function Filter_Value_N adds a new value to every channel and writes out the new outputs.
+ * @param p_filt pointer to the filter object
+ * @param in one new value per channel
+ * @param out one filtered value per channel (may be the same array as in)
+ */
+void  Filter_Value_N( Filter_Multi_t* p_filt, const float* in, float* out );
+
+/**
+ * Function Filter_Multi_Last_Output copies out every channel's most up-to-date filtered value without updating the
+ * filter.
+ * @param p_filt pointer to the filter object
+ * @param out one value per channel
+ */
+void  Filter_Multi_Last_Output( const Filter_Multi_t* p_filt, float* out );
 
 #endif
\ No newline at end of file
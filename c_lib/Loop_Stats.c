@@ -0,0 +1,182 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Loop_Stats.h"
+
+#include <util/atomic.h> // control tick channels are recorded from the Timer3 ISR
+
+typedef struct {
+    uint16_t start;         // [us] lower edge of the first bin
+    uint16_t deadline;      // [us] 0 for none
+    uint8_t  width_shift;   // bin width is 2^width_shift us
+    uint16_t min;
+    uint16_t max;
+    uint32_t count;
+    uint32_t sum;           // [us] total of the samples, for the mean
+    uint16_t misses;
+    uint16_t bins[LOOP_STATS_BINS];
+} Loop_Stats_Channel_t;
+
+#define LOOP_STATS_CHANNEL_INIT(START, SHIFT, DEADLINE) \
+    { .start = (START), .width_shift = (SHIFT), .deadline = (DEADLINE), .min = 0xFFFF }
+
+// Defaults cover the 1 ms message budget and a few ms of loop time; Control_Tick_Init reconfigures its channels
+// around the control period.
+static Loop_Stats_Channel_t _loop_stats[LOOP_STATS_CHANNELS] = {
+    [LOOP_STATS_MAIN_LOOP]      = LOOP_STATS_CHANNEL_INIT(0, 7, 1000),  // 128 us bins
+    [LOOP_STATS_MESSAGES]       = LOOP_STATS_CHANNEL_INIT(0, 6, 1000),  //  64 us bins
+    [LOOP_STATS_CONTROL_PERIOD] = LOOP_STATS_CHANNEL_INIT(0, 10, 0),
+    [LOOP_STATS_CONTROL_EXEC]   = LOOP_STATS_CHANNEL_INIT(0, 7, 0),
+    [LOOP_STATS_TASK(0) ... LOOP_STATS_CHANNELS - 1] = LOOP_STATS_CHANNEL_INIT(0, 6, 500),
+};
+
+/**
+ * Function _loop_stats_clear zeros a channel's samples. Call with interrupts off.
+ * @param p_channel [Loop_Stats_Channel_t*] channel to clear
+ */
+static void _loop_stats_clear( Loop_Stats_Channel_t* p_channel )
+{
+    p_channel->min    = 0xFFFF;
+    p_channel->max    = 0;
+    p_channel->count  = 0;
+    p_channel->sum    = 0;
+    p_channel->misses = 0;
+    for( uint8_t i = 0; i < LOOP_STATS_BINS; i++ ){
+        p_channel->bins[i] = 0;
+    }
+}
+
+/**
+ * Function Loop_Stats_Configure sets a channel's bins and deadline and clears it.
+ * @param channel [uint8_t] channel to configure
+ * @param start_us [uint16_t] lower edge of the first bin
+ * @param width_shift [uint8_t] bin width is 2^width_shift us
+ * @param deadline_us [uint16_t] samples longer than this are counted as misses, 0 for no deadline
+ */
+void Loop_Stats_Configure( uint8_t channel, uint16_t start_us, uint8_t width_shift, uint16_t deadline_us )
+{
+    if( channel >= LOOP_STATS_CHANNELS ) return;
+
+    if( width_shift > 15 ){
+        width_shift = 15;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        Loop_Stats_Channel_t* p_channel = &_loop_stats[channel];
+        p_channel->start       = start_us;
+        p_channel->width_shift = width_shift;
+        p_channel->deadline    = deadline_us;
+        _loop_stats_clear(p_channel);
+    }
+}
+
+/**
+ * Function Loop_Stats_Record adds a sample to a channel. Durations over 65535 us are recorded as 65535.
+ * @param channel [uint8_t] channel to record into (out of range channels are ignored)
+ * @param duration_us [uint32_t] measured duration
+ */
+void Loop_Stats_Record( uint8_t channel, uint32_t duration_us )
+{
+    if( channel >= LOOP_STATS_CHANNELS ) return;
+
+    Loop_Stats_Channel_t* p_channel = &_loop_stats[channel];
+    uint16_t us = (duration_us > 0xFFFF) ? 0xFFFF : duration_us;
+
+    uint16_t bin = 0;
+    if( us > p_channel->start ){
+        bin = (us - p_channel->start) >> p_channel->width_shift;
+        if( bin >= LOOP_STATS_BINS ){
+            bin = LOOP_STATS_BINS - 1;
+        }
+    }
+    if( p_channel->bins[bin] != 0xFFFF ){
+        p_channel->bins[bin]++;
+    }
+
+    if( us < p_channel->min ){
+        p_channel->min = us;
+    }
+    if( us > p_channel->max ){
+        p_channel->max = us;
+    }
+    if( p_channel->deadline != 0 && us > p_channel->deadline && p_channel->misses != 0xFFFF ){
+        p_channel->misses++;
+    }
+
+    p_channel->count++;
+    p_channel->sum += us;
+}
+
+/**
+ * Function Loop_Stats_Get fills in the report for a channel. The mean is only valid while the channel's summed
+ * time stays under 2^32 us (about 71 minutes), reset long-running channels before then.
+ * @param channel [uint8_t] channel to report
+ * @param p_report [Loop_Stats_Report_t*] filled with the channel's statistics
+ * @return [bool] false if the channel does not exist
+ */
+bool Loop_Stats_Get( uint8_t channel, Loop_Stats_Report_t* p_report )
+{
+    if( channel >= LOOP_STATS_CHANNELS ) return false;
+
+    Loop_Stats_Channel_t copy;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        copy = _loop_stats[channel];
+    }
+
+    p_report->channel  = channel;
+    p_report->start    = copy.start;
+    p_report->width    = 1u << copy.width_shift;
+    p_report->deadline = copy.deadline;
+    p_report->min      = (copy.count == 0) ? 0 : copy.min;
+    p_report->max      = copy.max;
+    p_report->mean     = (copy.count == 0) ? 0 : copy.sum / copy.count;
+    p_report->count    = copy.count;
+    p_report->misses   = copy.misses;
+    for( uint8_t i = 0; i < LOOP_STATS_BINS; i++ ){
+        p_report->bins[i] = copy.bins[i];
+    }
+
+    return true;
+}
+
+/**
+ * Function Loop_Stats_Reset clears a channel's samples, keeping its configuration.
+ * @param channel [uint8_t] channel to clear, or LOOP_STATS_ALL
+ */
+void Loop_Stats_Reset( uint8_t channel )
+{
+    for( uint8_t i = 0; i < LOOP_STATS_CHANNELS; i++ ){
+        if( channel != LOOP_STATS_ALL && channel != i ) continue;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            _loop_stats_clear(&_loop_stats[i]);
+        }
+    }
+}
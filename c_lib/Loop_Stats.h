@@ -0,0 +1,118 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Loop_Stats.h/c keeps fixed-bin timing histograms for the main loop, the control tick and the periodic tasks, so
+ * you can see where the loop spends its time before raising control rates.
+ *
+ * Each channel records durations in microseconds. A sample lands in bin (us - start) >> width_shift; samples below
+ * start go in the first bin and samples past the last bin in the last one. Each channel also keeps the sample
+ * count, min, max, sum (for the mean) and the number of samples over its deadline. Bin widths are powers of two so
+ * recording is cheap enough for the control tick ISR.
+ *
+ * Channels are recorded by:
+ *   LOOP_STATS_MAIN_LOOP       the lab's main loop (time between loop starts)
+ *   LOOP_STATS_MESSAGES        Message_Handling_Task (execution time)
+ *   LOOP_STATS_CONTROL_PERIOD  Control_Tick (time between ticks, shows jitter around the control period)
+ *   LOOP_STATS_CONTROL_EXEC    Control_Tick (execution time of a tick)
+ *   LOOP_STATS_TASK(i)         MSG_Scheduler_Run (execution time of the i-th registered task)
+ *
+ * Every channel is written by a single context (main loop or ISR) and read atomically, so recording needs no
+ * locking. The 'h'/'H' commands send a channel's report.
+ */
+#ifndef _LOOP_STATS_H
+#define _LOOP_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef LOOP_STATS_BINS
+#define LOOP_STATS_BINS 8           // histogram bins per channel
+#endif
+
+#ifndef LOOP_STATS_TASK_CHANNELS
+#define LOOP_STATS_TASK_CHANNELS 4  // scheduler tasks with their own channel, later tasks are not recorded
+#endif
+
+#define LOOP_STATS_MAIN_LOOP       0
+#define LOOP_STATS_MESSAGES        1
+#define LOOP_STATS_CONTROL_PERIOD  2
+#define LOOP_STATS_CONTROL_EXEC    3
+#define LOOP_STATS_TASK(i)         (4 + (i))
+#define LOOP_STATS_CHANNELS        LOOP_STATS_TASK(LOOP_STATS_TASK_CHANNELS)
+#define LOOP_STATS_ALL             0xFF // channel argument meaning every channel
+
+/**
+ * Report for one channel, as sent by the 'h'/'H' commands. All times are in microseconds.
+ */
+typedef struct __attribute__((__packed__)) {
+    uint8_t  channel;
+    uint16_t start;                 // lower edge of the first bin
+    uint16_t width;                 // bin width
+    uint16_t deadline;              // samples over this count as misses (0: no deadline)
+    uint16_t min;
+    uint16_t max;
+    uint16_t mean;
+    uint32_t count;                 // samples since the last reset
+    uint16_t misses;                // samples over the deadline
+    uint16_t bins[LOOP_STATS_BINS]; // samples per bin (saturating)
+} Loop_Stats_Report_t;
+
+/**
+ * Function Loop_Stats_Configure sets a channel's bins and deadline and clears it.
+ * @param channel [uint8_t] channel to configure
+ * @param start_us [uint16_t] lower edge of the first bin
+ * @param width_shift [uint8_t] bin width is 2^width_shift us
+ * @param deadline_us [uint16_t] samples longer than this are counted as misses, 0 for no deadline
+ */
+void Loop_Stats_Configure( uint8_t channel, uint16_t start_us, uint8_t width_shift, uint16_t deadline_us );
+
+/**
+ * Function Loop_Stats_Record adds a sample to a channel. Durations over 65535 us are recorded as 65535.
+ * @param channel [uint8_t] channel to record into (out of range channels are ignored)
+ * @param duration_us [uint32_t] measured duration
+ */
+void Loop_Stats_Record( uint8_t channel, uint32_t duration_us );
+
+/**
+ * Function Loop_Stats_Get fills in the report for a channel.
+ * @param channel [uint8_t] channel to report
+ * @param p_report [Loop_Stats_Report_t*] filled with the channel's statistics
+ * @return [bool] false if the channel does not exist
+ */
+bool Loop_Stats_Get( uint8_t channel, Loop_Stats_Report_t* p_report );
+
+/**
+ * Function Loop_Stats_Reset clears a channel's samples, keeping its configuration.
+ * @param channel [uint8_t] channel to clear, or LOOP_STATS_ALL
+ */
+void Loop_Stats_Reset( uint8_t channel );
+
+#endif
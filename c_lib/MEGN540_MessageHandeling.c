@@ -29,12 +29,20 @@
 */
 
 #include "MEGN540_MessageHandeling.h"
+#include "Control_Tick.h"
+#include "Loop_Stats.h"
+#include "Profile.h"
+
+#include <avr/pgmspace.h>
 
 
 static inline void MSG_FLAG_Init(MSG_FLAG_t* p_flag)
 {
     p_flag->active = false;
-    p_flag->duration = -1;
+    p_flag->period = 0;
+    p_flag->next_deadline = 0;
+    p_flag->missed = 0;
+    p_flag->time_limit = -1;
     p_flag->last_trigger_time.microsec = 0;
     p_flag->last_trigger_time.millisec = 0;
 }
@@ -47,9 +55,133 @@ static inline void MSG_FLAG_Init(MSG_FLAG_t* p_flag)
  */
 bool MSG_FLAG_Execute(MSG_FLAG_t* p_flag)
 {
-    // If active and duration is less than (or equal to) the last trigger time, return true,
-    // otherwise, return false
-    return p_flag->active;
+    if(!p_flag->active) return false;
+    if(p_flag->period == 0) return true;
+
+    // Integer compare of the difference so the millisecond counter rolling over does not matter
+    uint32_t now = GetMilli();
+    if((int32_t)(now - p_flag->next_deadline) < 0) return false;
+
+    // Advance from the deadline, not from now, so the stream does not drift
+    p_flag->next_deadline += p_flag->period;
+
+    // Fell a whole period (or more) behind: skip the missed executions rather than bursting to catch up
+    if((int32_t)(now - p_flag->next_deadline) >= 0){
+        uint32_t behind = (now - p_flag->next_deadline) / p_flag->period + 1;
+        p_flag->missed += behind;
+        p_flag->next_deadline += behind * p_flag->period;
+    }
+
+    return true;
+}
+
+/**
+ * Function MSG_FLAG_Set_Period activates a flag as a periodic stream. The first execution is due one period from now.
+ * @param p_flag [MSG_FLAG_t*] flag to activate
+ * @param period_ms [uint16_t] repeat period in milliseconds, 0 for a one-shot
+ */
+void MSG_FLAG_Set_Period(MSG_FLAG_t* p_flag, uint16_t period_ms)
+{
+    p_flag->period = period_ms;
+    p_flag->next_deadline = GetMilli() + period_ms;
+    p_flag->missed = 0;
+    p_flag->active = true;
+}
+
+/**
+ * Function _msg_period_ms converts a host supplied period to whole milliseconds, clipped to what MSG_FLAG_t holds.
+ * Positive periods are at least 1 ms so they stay periodic.
+ */
+static uint16_t _msg_period_ms(float period_ms)
+{
+    if(period_ms >= 65535) return 65535;
+    if(period_ms <= 1)     return 1;
+    return (uint16_t)(period_ms + 0.5f);
+}
+
+// Registered tasks (see MSG_Scheduler_Add)
+static struct { MSG_FLAG_t* p_flag; MSG_Task_t task; } _msg_tasks[MSG_SCHEDULER_MAX_TASKS];
+static uint8_t _msg_task_count = 0;
+
+/**
+ * Function MSG_Scheduler_Add registers a task to run whenever its flag is due. Registered tasks are run by
+ * MSG_Scheduler_Run, earliest deadline first.
+ * @param p_flag [MSG_FLAG_t*] flag controlling the task
+ * @param task [MSG_Task_t] function to run, it receives the flag
+ * @return [bool] False if MSG_SCHEDULER_MAX_TASKS tasks are already registered
+ */
+bool MSG_Scheduler_Add(MSG_FLAG_t* p_flag, MSG_Task_t task)
+{
+    for(uint8_t i = 0; i < _msg_task_count; i++){
+        if(_msg_tasks[i].p_flag == p_flag){
+            _msg_tasks[i].task = task;
+            return true;
+        }
+    }
+
+    if(_msg_task_count >= MSG_SCHEDULER_MAX_TASKS) return false;
+
+    _msg_tasks[_msg_task_count].p_flag = p_flag;
+    _msg_tasks[_msg_task_count].task   = task;
+    _msg_task_count++;
+    return true;
+}
+
+/**
+ * Function MSG_Scheduler_Run runs every registered task whose flag is due, in order of deadline. One-shot flags
+ * (period 0) are due immediately and run first.
+ */
+void MSG_Scheduler_Run()
+{
+    uint8_t  due[MSG_SCHEDULER_MAX_TASKS];
+    uint8_t  due_count = 0;
+    uint32_t now = GetMilli();
+
+    // Collect the due tasks, insertion sorted by how late they are (most late first)
+    for(uint8_t i = 0; i < _msg_task_count; i++){
+        MSG_FLAG_t* p_flag = _msg_tasks[i].p_flag;
+        if(!p_flag->active) continue;
+
+        int32_t late = (p_flag->period == 0) ? INT32_MAX : (int32_t)(now - p_flag->next_deadline);
+        if(late < 0) continue;
+
+        uint8_t j = due_count++;
+        for(; j > 0; j--){
+            MSG_FLAG_t* p_prev = _msg_tasks[due[j-1]].p_flag;
+            int32_t prev_late = (p_prev->period == 0) ? INT32_MAX : (int32_t)(now - p_prev->next_deadline);
+            if(prev_late >= late) break;
+            due[j] = due[j-1];
+        }
+        due[j] = i;
+    }
+
+    for(uint8_t k = 0; k < due_count; k++){
+        MSG_FLAG_t* p_flag = _msg_tasks[due[k]].p_flag;
+
+        // Execute advances the deadline (and counts any missed periods) before the task runs
+        if(MSG_FLAG_Execute(p_flag)){
+            uint32_t task_start = GetMicros32();
+            _msg_tasks[due[k]].task(p_flag);
+            Loop_Stats_Record(LOOP_STATS_TASK(due[k]), GetMicros32() - task_start);
+        }
+    }
+}
+
+/**
+ * Function MSG_Scheduler_Missed returns the total number of missed periodic deadlines of the registered tasks.
+ * @param reset [bool] zero the counters after reading them
+ * @return [uint16_t] missed deadlines
+ */
+uint16_t MSG_Scheduler_Missed(bool reset)
+{
+    uint16_t missed = 0;
+
+    for(uint8_t i = 0; i < _msg_task_count; i++){
+        missed += _msg_tasks[i].p_flag->missed;
+        if(reset) _msg_tasks[i].p_flag->missed = 0;
+    }
+
+    return missed;
 }
 
 
@@ -71,408 +203,474 @@ void Message_Handling_Init()
     MSG_FLAG_Init(&mf_stop_PWM);
     MSG_FLAG_Init(&mf_distance_mode);
     MSG_FLAG_Init(&mf_velocity_mode);
+    MSG_FLAG_Init(&mf_send_sys_batch);
+}
+
+/*
+ * Command payloads. Each is the DATA that follows the command char, exactly as the host packs it.
+ */
+typedef struct __attribute__((__packed__)) { float v1; float v2; }                           MSG_Two_Floats_t;
+typedef struct __attribute__((__packed__)) { uint8_t B; }                                    MSG_Byte_t;
+typedef struct __attribute__((__packed__)) { uint8_t B; float f; }                           MSG_Byte_Float_t;
+typedef struct __attribute__((__packed__)) { float f; }                                      MSG_Float_t;
+typedef struct __attribute__((__packed__)) { int16_t left_PWM; int16_t right_PWM; }          MSG_PWM_t;
+typedef struct __attribute__((__packed__)) { int16_t left_PWM; int16_t right_PWM; float duration; } MSG_PWM_Timed_t;
+typedef struct __attribute__((__packed__)) { float period; uint8_t K; }                      MSG_Batch_t;
+typedef struct __attribute__((__packed__)) { float linear; float angular; }                  MSG_Move_t;
+typedef struct __attribute__((__packed__)) { float linear; float angular; float duration; }  MSG_Move_Timed_t;
+
+/*
+ * Command handlers. Each gets the command char and a pointer to its already decoded payload (NULL for commands
+ * without one). The command char and payload have been removed from the receive buffer.
+ */
+
+static void _msg_arithmetic(char command, const void* p_payload)
+{
+    // case '*', '/', '+', '-' multiply, divide, add, or subtract two floats and return the float result
+    const MSG_Two_Floats_t* data = p_payload;
+    float ret_val;
+
+    switch(command){
+        case '*': ret_val = data->v1 * data->v2; break;
+        case '/': ret_val = data->v1 / data->v2; break;
+        case '+': ret_val = data->v1 + data->v2; break;
+        default:  ret_val = data->v1 - data->v2; break;
+    }
+
+    // send response right here if appropriate.
+    usb_send_msg("cf", command, &ret_val, sizeof(ret_val));
+}
+
+static void _msg_time(char command, const void* p_payload)
+{
+    // case 't' returns the time it requested followed by the time to complete the action specified by the second input char.
+    uint8_t sc = ((const MSG_Byte_t*)p_payload)->B;
+
+    mf_send_time.command    = command;
+    mf_send_time.subcommand = sc;
+
+    if(sc == 0){    // send time now
+        mf_send_time.active = true; // set flag to true so it knows to send time
+    }else if(sc == 1){  // send time to complete one full loop iteration
+        MSG_FLAG_Set_Period(&mf_loop_timer, 0);
+    }else if(sc == 2){  // send time to send float
+        MSG_FLAG_Set_Period(&mf_time_float_send, 0);
+    }else{
+        usb_send_msg("cc", '?', &sc, sizeof(sc));
+    }
+}
+
+static void _msg_time_repeat(char command, const void* p_payload)
+{
+    // case 'T' returns the time it requested followed by the time to complete the action specified by the second input char
+    // and returns the time every X milliseconds. If the time is zero or negative it cancels the request without response.
+    const MSG_Byte_Float_t* data = p_payload;
+
+    if(data->B <= 0){   // cancel request without response
+        MSG_FLAG_Init(&mf_send_time);
+        MSG_FLAG_Init(&mf_loop_timer);
+        MSG_FLAG_Init(&mf_time_float_send);
+    }else if(data->B == 1){   // send time every 'duration' milliseconds
+        MSG_FLAG_Set_Period(&mf_send_time, _msg_period_ms(data->f));
+        mf_send_time.command = command;
+        mf_send_time.subcommand = data->B;
+    }else if(data->B == 2){   // send time to complete one loop iteration
+        MSG_FLAG_Set_Period(&mf_loop_timer, _msg_period_ms(data->f));
+        mf_loop_timer.command = command;
+        mf_loop_timer.subcommand = data->B;
+    }else if(data->B == 3){  // send time to send float
+        MSG_FLAG_Set_Period(&mf_time_float_send, _msg_period_ms(data->f));
+        mf_time_float_send.command = command;
+        mf_time_float_send.subcommand = data->B;
+    }else{
+        uint8_t sc = data->B;
+        usb_send_msg("cc", '?', &sc, sizeof(sc));
+    }
+}
+
+static void _msg_encoder(char command, const void* p_payload)
+{
+    // case 'e' returns the left and right encoder values [in radians]
+    MSG_FLAG_Set_Period(&mf_send_encoder, 0);
+    mf_send_encoder.command = command;
+}
+
+static void _msg_encoder_repeat(char command, const void* p_payload)
+{
+    // case 'E' returns the left and right encoder values [in radians] every X milliseconds specified by float sent.
+    // If the float sent is less-than-or-equal-to zero, the request is canceled.
+    const MSG_Float_t* data = p_payload;
+
+    if(data->f <= 0){   // cancel request without response
+        MSG_FLAG_Init(&mf_send_encoder);
+    }else {   // send encoders every 'f' milliseconds
+        MSG_FLAG_Set_Period(&mf_send_encoder, _msg_period_ms(data->f));
+        mf_send_encoder.command = command;
+    }
+}
+
+static void _msg_voltage(char command, const void* p_payload)
+{
+    // case 'b' returns the current battery voltage level
+    MSG_FLAG_Set_Period(&mf_send_voltage, 0);
+    mf_send_voltage.command = command;
+}
+
+static void _msg_voltage_repeat(char command, const void* p_payload)
+{
+    // case 'B' returns the current battery voltage level every X seconds as sepcified by the float sent.
+    // If the float is less-than-or-equal-to zero, the request is canceled.
+    const MSG_Float_t* data = p_payload;
+
+    if(data->f <= 0){   // cancel request without response
+        MSG_FLAG_Init(&mf_send_voltage);
+    }else {   // send voltage every 'f' seconds
+        MSG_FLAG_Set_Period(&mf_send_voltage, _msg_period_ms(data->f*1000));
+        mf_send_voltage.command = command;
+    }
+}
+
+static void _msg_PWM(char command, const void* p_payload)
+{
+    // case 'p' sets the PWM command for the left (1st) and right (2nd) side with the sign indicating direction (if power is in acceptable range).
+    const MSG_PWM_t* data = p_payload;
+
+    // Store left & right PWM values
+    PWM_data.left_PWM  = data->left_PWM;
+    PWM_data.right_PWM = data->right_PWM;
+    PWM_data.timed     = false;
+
+    mf_set_PWM.active = true;
+}
+
+static void _msg_PWM_timed(char command, const void* p_payload)
+{
+    // case 'P' sets the PWM command for the left (1st) and right (2nd) side with the sign indicating direction (if power is in acceptable range).
+    // The following float value provides the duration (in ms) to have the PWM at the specified value, then return to 0 PWM (stopped) once that time duration is reached.
+    const MSG_PWM_Timed_t* data = p_payload;
+
+    // Store left & right PWM values and duration
+    PWM_data.left_PWM  = data->left_PWM;
+    PWM_data.right_PWM = data->right_PWM;
+    PWM_data.duration  = data->duration;
+    PWM_data.timed     = true;
+
+    mf_set_PWM.active   = true;
+    mf_set_PWM.last_trigger_time = GetTime();
+    mf_set_PWM.time_limit = PWM_data.duration;   // already in ms
+}
+
+static void _msg_stop(char command, const void* p_payload)
+{
+    // case 's' and 'S' stop PWM and disable motor system
+    mf_stop_PWM.active = true;
+    usb_flush_input_buffer();
+}
+
+static void _msg_sys_info(char command, const void* p_payload)
+{
+    // case 'q' sends system identification data back to host.
+    MSG_FLAG_Set_Period(&mf_send_sys_info, 0);
+}
+
+static void _msg_sys_info_repeat(char command, const void* p_payload)
+{
+    // case 'Q' sends the system identification information back to the host every X ms (as specified in the second float).
+    // If this float is zero or negative, then the repeat send request is canceled.
+    const MSG_Float_t* data = p_payload;
+
+    if(data->f <= 0){
+        MSG_FLAG_Set_Period(&mf_send_sys_info, 0);
+    }else{
+        MSG_FLAG_Set_Period(&mf_send_sys_info, _msg_period_ms(data->f));
+    }
+}
+
+static void _msg_sys_batch(char command, const void* p_payload)
+{
+    // case 'R' streams system identification samples every X ms (first float), packed K (uint8_t) samples to
+    // a frame. If the float is zero or negative, the stream is stopped after sending what was collected. A new K
+    // while streaming takes effect once the main loop has sent the partial batch packed at the old K.
+    const MSG_Batch_t* data = p_payload;
+
+    if(data->period <= 0){
+        if(mf_send_sys_batch.active) mf_send_sys_batch.period = 0; // main loop flushes and deactivates
+    }else{
+        MSG_FLAG_Set_Period(&mf_send_sys_batch, _msg_period_ms(data->period));
+        mf_send_sys_batch.subcommand = data->K;
+    }
+}
+
+static void _msg_distance(char command, const void* p_payload)
+{
+    // case 'd' specifies the distance to drive (linear followed by angular).
+    const MSG_Move_t* data = p_payload;
+
+    mf_distance_mode.active = true;
+
+    Dist_data.linear  = data->linear/1000;
+    Dist_data.angular = data->angular*3.0;
+}
+
+static void _msg_distance_timed(char command, const void* p_payload)
+{
+    // case 'D' specifies the distance to drive (linear followed by angular), terminates after X milliseconds as specified by the third float.
+    // If the third float is negative, the car shall stop.
+    const MSG_Move_Timed_t* data = p_payload;
+
+    if(data->duration < 0){
+        mf_distance_mode.active = false;
+        mf_stop_PWM.active = true;
+    }else{
+        mf_stop_PWM.active = false;
+        mf_distance_mode.active = true;
+        mf_distance_mode.time_limit = data->duration;
+    }
+    Dist_data.linear  = data->linear/1000;
+    Dist_data.angular = data->angular*3.0;
+}
+
+static void _msg_velocity(char command, const void* p_payload)
+{
+    // case 'v' specifies the speed to drive (linear followed by angular).
+    const MSG_Move_t* data = p_payload;
+
+    mf_velocity_mode.active = true;
+
+    Veloc_data.linear  = data->linear/1000;
+    Veloc_data.angular = data->angular;
+}
+
+static void _msg_velocity_timed(char command, const void* p_payload)
+{
+    // case 'V' specifies the speed to drive (linear followed by angular), terminates after X milliseconds as specified by the third float.
+    // If the third float is negative, the car shall stop.
+    const MSG_Move_Timed_t* data = p_payload;
+
+    if(data->duration < 0){
+        mf_velocity_mode.active = false;
+        mf_stop_PWM.active = true;
+    }else{
+        mf_velocity_mode.active = true;
+        mf_velocity_mode.time_limit = data->duration;
+    }
+    Veloc_data.linear  = data->linear;
+    Veloc_data.angular = data->angular;
 }
 
+static void _msg_usb_stats(char command, const void* p_payload)
+{
+    // case 'u' returns the USB buffer drop counters and high-water marks (send buffer then receive buffer).
+    // case 'U' does the same and then zeros them.
+    struct __attribute__((__packed__)) { USB_Buffer_Stats_t send; USB_Buffer_Stats_t receive; } stats;
+    usb_get_buffer_stats(&stats.send, &stats.receive);
+
+    if(command == 'U'){
+        usb_reset_buffer_stats();
+    }
+
+    usb_send_msg("cHHBHHB", command, &stats, sizeof(stats));
+}
+
+static void _msg_missed_deadlines(char command, const void* p_payload)
+{
+    // case 'k' returns the number of periodic deadlines the scheduled tasks have missed.
+    // case 'K' does the same and then zeros the counters.
+    uint16_t missed = MSG_Scheduler_Missed(command == 'K');
+
+    usb_send_msg("cH", command, &missed, sizeof(missed));
+}
+
+static void _msg_control_tick_stats(char command, const void* p_payload)
+{
+    // case 'c' returns the control tick timing statistics: tick count, overruns, worst latency and the last, min and
+    // max execution times, all in CPU cycles.
+    // case 'C' does the same and then zeros them.
+    Control_Tick_Stats_t stats;
+    Control_Tick_Get_Stats(&stats);
+
+    if(command == 'C'){
+        Control_Tick_Reset_Stats();
+    }
+
+    usb_send_msg("cLHHHHH", command, &stats, sizeof(stats));
+}
+
+_Static_assert(LOOP_STATS_BINS == 8, "'h' report format string assumes 8 histogram bins");
+
+static void _msg_loop_stats(char command, const void* p_payload)
+{
+    // case 'h' returns the timing histogram of one channel (see Loop_Stats.h), or of every channel for 0xFF.
+    // case 'H' does the same and then clears the channel(s).
+    uint8_t channel = ((const MSG_Byte_t*)p_payload)->B;
+    Loop_Stats_Report_t report;
+
+    if(channel != LOOP_STATS_ALL && channel >= LOOP_STATS_CHANNELS){
+        usb_send_msg("cc", '?', &channel, sizeof(channel));
+        return;
+    }
+
+    for(uint8_t i = 0; i < LOOP_STATS_CHANNELS; i++){
+        if(channel != LOOP_STATS_ALL && channel != i) continue;
+
+        Loop_Stats_Get(i, &report);
+        usb_send_msg("cB6HLH8H", command, &report, sizeof(report));
+    }
+
+    if(command == 'H'){
+        Loop_Stats_Reset(channel);
+    }
+}
+
+static void _msg_profile(char command, const void* p_payload)
+{
+    // case 'f' returns the cycle profile of every section (see Profile.h), one message per section.
+    // case 'F' does the same and then clears the table.
+    Profile_Entry_t entry;
+
+    for(uint8_t id = 0; id < PROFILE_COUNT; id++){
+        Profile_Get(id, &entry);
+        usb_send_msg("cBLLHH", command, &entry, sizeof(entry));
+    }
+
+    if(command == 'F'){
+        Profile_Reset();
+    }
+}
+
+static void _msg_announce_formats(char command, const void* p_payload)
+{
+    // case '#' asks the device to re-announce its registered format IDs (sent by the host on connect).
+    usb_announce_formats();
+}
+
+static void _msg_restart(char command, const void* p_payload)
+{
+    // case '~' resets by setting the mf_restart flag
+    usb_flush_input_buffer();
+    mf_restart.active = true;
+}
+
+/*
+ * Command table, indexed by command char and stored in flash. Adding a command is one row here plus its handler.
+ * MSG_COMMAND sizes the payload from its struct and refuses (at compile time) payloads larger than
+ * MSG_MAX_PAYLOAD. Unlisted chars have no handler and are answered with '?'.
+ */
+#define MSG_MAX_PAYLOAD 16
+typedef void (*MSG_Handler_t)(char command, const void* p_payload);
+typedef struct { uint8_t payload_len; MSG_Handler_t handler; } MSG_Command_t;
+
+#define MSG_COMMAND(PAYLOAD_T, HANDLER) \
+    { sizeof(PAYLOAD_T) + 0*sizeof(char[(sizeof(PAYLOAD_T) <= MSG_MAX_PAYLOAD) ? 1 : -1]), HANDLER }
+#define MSG_COMMAND_NO_PAYLOAD(HANDLER) { 0, HANDLER }
+
+static const MSG_Command_t _msg_commands[128] PROGMEM = {
+    ['*'] = MSG_COMMAND(MSG_Two_Floats_t, _msg_arithmetic),
+    ['/'] = MSG_COMMAND(MSG_Two_Floats_t, _msg_arithmetic),
+    ['+'] = MSG_COMMAND(MSG_Two_Floats_t, _msg_arithmetic),
+    ['-'] = MSG_COMMAND(MSG_Two_Floats_t, _msg_arithmetic),
+    ['t'] = MSG_COMMAND(MSG_Byte_t,       _msg_time),
+    ['T'] = MSG_COMMAND(MSG_Byte_Float_t, _msg_time_repeat),
+    ['e'] = MSG_COMMAND_NO_PAYLOAD(       _msg_encoder),
+    ['E'] = MSG_COMMAND(MSG_Float_t,      _msg_encoder_repeat),
+    ['b'] = MSG_COMMAND_NO_PAYLOAD(       _msg_voltage),
+    ['B'] = MSG_COMMAND(MSG_Float_t,      _msg_voltage_repeat),
+    ['p'] = MSG_COMMAND(MSG_PWM_t,        _msg_PWM),
+    ['P'] = MSG_COMMAND(MSG_PWM_Timed_t,  _msg_PWM_timed),
+    ['s'] = MSG_COMMAND_NO_PAYLOAD(       _msg_stop),
+    ['S'] = MSG_COMMAND_NO_PAYLOAD(       _msg_stop),
+    ['q'] = MSG_COMMAND_NO_PAYLOAD(       _msg_sys_info),
+    ['Q'] = MSG_COMMAND(MSG_Float_t,      _msg_sys_info_repeat),
+    ['R'] = MSG_COMMAND(MSG_Batch_t,      _msg_sys_batch),
+    ['d'] = MSG_COMMAND(MSG_Move_t,       _msg_distance),
+    ['D'] = MSG_COMMAND(MSG_Move_Timed_t, _msg_distance_timed),
+    ['v'] = MSG_COMMAND(MSG_Move_t,       _msg_velocity),
+    ['V'] = MSG_COMMAND(MSG_Move_Timed_t, _msg_velocity_timed),
+    ['u'] = MSG_COMMAND_NO_PAYLOAD(       _msg_usb_stats),
+    ['U'] = MSG_COMMAND_NO_PAYLOAD(       _msg_usb_stats),
+    ['k'] = MSG_COMMAND_NO_PAYLOAD(       _msg_missed_deadlines),
+    ['K'] = MSG_COMMAND_NO_PAYLOAD(       _msg_missed_deadlines),
+    ['c'] = MSG_COMMAND_NO_PAYLOAD(       _msg_control_tick_stats),
+    ['C'] = MSG_COMMAND_NO_PAYLOAD(       _msg_control_tick_stats),
+    ['h'] = MSG_COMMAND(MSG_Byte_t,       _msg_loop_stats),
+    ['H'] = MSG_COMMAND(MSG_Byte_t,       _msg_loop_stats),
+    ['f'] = MSG_COMMAND_NO_PAYLOAD(       _msg_profile),
+    ['F'] = MSG_COMMAND_NO_PAYLOAD(       _msg_profile),
+    ['#'] = MSG_COMMAND_NO_PAYLOAD(       _msg_announce_formats),
+    ['~'] = MSG_COMMAND_NO_PAYLOAD(       _msg_restart),
+};
+
 /**
- * Function Message_Handler processes USB messages as necessary and sets status flags to control the flow of the program.
- * It returns true unless the program receives a reset message.
- * @return
+ * Function _msg_command_handler looks up a command's handler in the command table.
+ * @return [MSG_Handler_t] the handler, NULL if the command is not recognized
  */
-void Message_Handling_Task()
+static inline MSG_Handler_t _msg_command_handler(char cmd)
+{
+    if((uint8_t)cmd >= sizeof(_msg_commands)/sizeof(_msg_commands[0])) return NULL;
+    return (MSG_Handler_t)pgm_read_word(&_msg_commands[(uint8_t)cmd].handler);
+}
+
+// Time Message_Handling_Task may spend parsing commands per call [us]
+static uint32_t _msg_time_budget_us = MSG_DEFAULT_TIME_BUDGET;
+
+/**
+ * Function Message_Handling_Set_Time_Budget sets how long one call to Message_Handling_Task may keep processing
+ * commands. At least one complete command is always processed.
+ * @param budget_us [uint32_t] time budget per call in microseconds, zero processes one command per call
+ */
+void Message_Handling_Set_Time_Budget(uint32_t budget_us)
 {
-    // I suggest you use your peak function and a switch interface
-    // Either do the simple stuff strait up, set flags to have it done later.
-    // If it just is a USB thing, do it here, if it requires other hardware, do it in the main and
-    // set a flag to have it done here.
+    _msg_time_budget_us = budget_us;
+}
 
+/**
+ * Function _msg_process_one handles the command at the front of the receive buffer if it is complete.
+ * @return [bool] True if a command was consumed, False if the buffer is empty or holds only a partial command
+ */
+static bool _msg_process_one()
+{
     // Check to see if their is data in waiting
-    if(usb_msg_length() == 0) return; // nothing to process...
+    if(usb_msg_length() == 0) return false; // nothing to process...
 
     // Get Your command designator without removal so if their are not enough bytes yet, the command persists
     char command = usb_msg_peek();
 
-    // process command
-    switch(command){
-        case '*':
-            if(usb_msg_length() >= MEGN540_Message_Len('*')){
-                // then process your times...
-                // remove the command from the usb recieved buffer using the usb_msg_get() function
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a * so no need to save it as a variable
-
-                // Build a meaningful structure to put your data in. Here we want two floats.
-                struct __attribute__((__packed__)) { float v1; float v2; } data;
-
-                // Copy the bytes from the usb receive buffer into our structure so we can use the information
-                usb_msg_read_into( &data, sizeof(data) );
-
-                // Do the thing you need to do. Here we want to multiply.
-                float ret_val = data.v1 * data.v2;
-
-                // send response right here if appropriate.
-                usb_send_msg("cf", command, &ret_val, sizeof(ret_val));
-            }
-            break;
-        case '/':
-            if(usb_msg_length() >= MEGN540_Message_Len('/')){
-                // then process your divide...
-                // remove the command from the usb recieved buffer using the usb_msg_get() function
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a / so no need to save it as a variable
-
-                // Build a meaningful structure to put your data in. Here we want two floats.
-                struct __attribute__((__packed__)) { float v1; float v2; } data;
-
-                // Copy the bytes from the usb receive buffer into our structure so we can use the information
-                usb_msg_read_into(&data, sizeof(data) );
-
-                // Do the thing you need to do. Here we want to divide.
-                float ret_val = data.v1 / data.v2;
-
-                // send response right here if appropriate.
-                usb_send_msg("cf", command, &ret_val, sizeof(ret_val));
-            }
-            break;
-        case '+':
-            if(usb_msg_length() >= MEGN540_Message_Len('+')){
-                // then process your plus...
-                // remove the command from the usb recieved buffer using the usb_msg_get() function
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a + so no need to save it as a variable
-
-                // Build a meaningful structure to put your data in. Here we want two floats.
-                struct __attribute__((__packed__)) { float v1; float v2; } data;
-
-                // Copy the bytes from the usb receive buffer into our structure so we can use the information
-                usb_msg_read_into( &data, sizeof(data) );
-
-                // Do the thing you need to do. Here we want to add.
-                float ret_val = data.v1 + data.v2;
-
-                // send response right here if appropriate.
-                usb_send_msg("cf", command, &ret_val, sizeof(ret_val));
-            }
-            break;
-        case '-':
-            if(usb_msg_length() >= MEGN540_Message_Len('-')){
-                // then process your minus...
-                // remove the command from the usb recieved buffer using the usb_msg_get() function
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a - so no need to save it as a variable
-
-                // Build a meaningful structure to put your data in. Here we want two floats.
-                struct __attribute__((__packed__)) { float v1; float v2; } data;
-
-                // Copy the bytes from the usb receive buffer into our structure so we can use the information
-                usb_msg_read_into( &data, sizeof(data) );
-
-                // Do the thing you need to do. Here we want to subtract.
-                float ret_val = data.v1 - data.v2;
-
-                // send response right here if appropriate.
-                usb_send_msg("cf", command, &ret_val, sizeof(ret_val));
-            }
-            break;
-        case 't':
-            // case 't' returns the time it requested followed by the time to complete the action specified by the second input char. 
-            if(usb_msg_length() >= MEGN540_Message_Len('t')){
-                // then process your t...
-                //uint8_t subcommand = usb_msg_peek_ahead(1);
-
-                mf_send_time.command = usb_msg_get();
-
-                uint8_t sc = usb_msg_get();
-
-                mf_send_time.subcommand = sc;
-
-                if(sc == 0){    // send time now
-                    mf_send_time.active = true; // set flag to true so it knows to send time
-                }else if(sc == 1){  // send time to complete one full loop iteration
-                    mf_loop_timer.active = true;
-                    mf_loop_timer.last_trigger_time = GetTime();
-                    mf_loop_timer.duration = -1;
-                }else if(sc == 2){  // send time to send float
-                    mf_time_float_send.active = true;
-                    mf_time_float_send.last_trigger_time = GetTime();
-                    mf_time_float_send.duration = -1;
-                }else{
-                    usb_send_msg("cc", '?', &sc, sizeof(sc));
-                }
-            }
-            break;
-        case 'T':
-            // case 'T' returns the time it requested followed by the time to complete the action specified by the second input char
-            // and returns the time every X milliseconds. If the time is zero or negative it cancels the request without response.
-            if(usb_msg_length() >= MEGN540_Message_Len('T')){
-                // then process your T...
-                //uint8_t subcommand = usb_msg_peek_ahead(1);
-                //uint8_t durcommand = usb_msg_peek_ahead(2);
-
-                char c = usb_msg_get();
-
-                struct __attribute__((__packed__)) { uint8_t B; float f; } data;
-
-                usb_msg_read_into( &data, sizeof(data) );
-
-                if(data.B <= 0){   // cancel request without response
-                    MSG_FLAG_Init(&mf_send_time);
-                    MSG_FLAG_Init(&mf_loop_timer);
-                    MSG_FLAG_Init(&mf_time_float_send);
-                }else if(data.B == 1){   // send time every 'duration' milliseconds
-                    mf_send_time.active = true;
-                    mf_send_time.last_trigger_time = GetTime();
-                    mf_send_time.duration = data.f/1000.0;
-                    mf_send_time.command = c;
-                    mf_send_time.subcommand = data.B;
-                }else if(data.B == 2){   // send time to complete one loop iteration
-                    mf_loop_timer.active = true;
-                    mf_loop_timer.last_trigger_time = GetTime();
-                    mf_loop_timer.duration = data.f/1000.0;
-                    mf_loop_timer.command = c;
-                    mf_loop_timer.subcommand = data.B;
-                }else if(data.B == 3){  // send time to send float
-                    mf_time_float_send.active = true;
-                    mf_time_float_send.last_trigger_time = GetTime();
-                    mf_time_float_send.duration = data.f/1000.0;
-                    mf_time_float_send.command = c;
-                    mf_time_float_send.subcommand = data.B;
-                }else{
-                    usb_send_msg("cc", '?', &data.B, sizeof(data.B));
-                }
-            }
-            break;
-        case 'e':
-            // case 'e' returns the left and right encoder values [in radians]
-            if(usb_msg_length() >= MEGN540_Message_Len('e')){
-                // then process your e...
-                char c = usb_msg_get(); // removes the first character from the received buffer, we already know it was a e so no need to save it as a variable
-                     
-                mf_send_encoder.active = true;
-                mf_send_encoder.command = c;
-            }
-            break;
-        case 'E':
-            // case 'E' returns the left and right encoder values [in radians] every X milliseconds specified by float sent.
-            // If the float sent is less-than-or-equal-to zero, the request is canceled.
-            if(usb_msg_length() >= MEGN540_Message_Len('E')){
-                // then process your E...
-                char c = usb_msg_get();
-                
-                struct __attribute__((__packed__)) { float f; } data;
-
-                usb_msg_read_into( &data, sizeof(data) );
-                     
-                if(data.f <= 0){   // cancel request without response
-                    MSG_FLAG_Init(&mf_send_encoder);
-                }else {   // send time every 'duration' milliseconds
-                    mf_send_encoder.active = true;
-                    mf_send_encoder.last_trigger_time = GetTime();
-                    mf_send_encoder.duration = data.f/1000.0;
-                    mf_send_encoder.command = c;
-                }
-            }
-            break;
-        case 'b':
-            // case 'b' returns the current battery voltage level
-            if(usb_msg_length() >= MEGN540_Message_Len('b')){
-                // then process your b...
-                char c = usb_msg_get(); // removes the first character from the received buffer, we already know it was a b so no need to save it as a variable
-                     
-                mf_send_voltage.active = true;
-                mf_send_voltage.command = c;
-            }
-            break;
-        case 'B':
-            // case 'B' returns the current battery voltage level every X seconds as sepcified by the float sent.
-            // If the float is less-than-or-equal-to zero, the request is canceled.
-            if(usb_msg_length() >= MEGN540_Message_Len('B')){
-                // then process your B...
-                char c = usb_msg_get();
-                
-                struct __attribute__((__packed__)) { float f; } data;
-
-                usb_msg_read_into( &data, sizeof(data) );
-                     
-                if(data.f <= 0){   // cancel request without response
-                    MSG_FLAG_Init(&mf_send_voltage);
-                }else {   // send time every 'duration' seconds
-                    mf_send_voltage.active = true;
-                    mf_send_voltage.last_trigger_time = GetTime();
-                    mf_send_voltage.duration = data.f;
-                    mf_send_voltage.command = c;
-                }
-            }
-            break;
-        case 'p':
-            // case 'p' sets the PWM command for the left (1st) and right (2nd) side with the sign indicating direction (if power is in acceptable range).
-            if(usb_msg_length() >= MEGN540_Message_Len('p')){
-                // then process your p...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a p so no need to save it as a variable
-		        
-                struct __attribute__((__packed__)) { int16_t left_PWM; int16_t right_PWM; } data;
-                // Read PWM data from buffer
-		        usb_msg_read_into(&data, sizeof(data));
-
-                // Store left & right PWM values 
-                PWM_data.left_PWM  = data.left_PWM;
-                PWM_data.right_PWM = data.right_PWM;
-		        PWM_data.timed     = false;
-
-		        mf_set_PWM.active = true;
-            }
-            break;
-        case 'P':
-            // case 'P' sets the PWM command for the left (1st) and right (2nd) side with the sign indicating direction (if power is in acceptable range).
-            // The following float value provides the duration (in ms) to have the PWM at the specified value, then return to 0 PWM (stopped) once that time duration is reached.
-            if(usb_msg_length() >= MEGN540_Message_Len('P')){
-                // then process your P...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a P so no need to save it as a variable
-		        
-                struct __attribute__((__packed__)) { int16_t left_PWM; int16_t right_PWM; float duration;} data;
-
-                // Read PWM data from buffer
-		        usb_msg_read_into(&data, sizeof(data));
-
-                // Store left & right PWM values and duration
-                PWM_data.left_PWM  = data.left_PWM;
-                PWM_data.right_PWM = data.right_PWM;
-                PWM_data.duration  = data.duration;
-		        PWM_data.timed     = true;
-
-		        mf_set_PWM.active   = true;
-                mf_set_PWM.last_trigger_time = GetTime();
-		        mf_set_PWM.duration = PWM_data.duration/1000;   // Divide by 1000 to convert ms to sec
-            }
-            break;
-        case 's':
-            // case 's' stops PWM and disable motor system
-            if(usb_msg_length() >= MEGN540_Message_Len('s')){
-                mf_stop_PWM.active = true;
-                usb_flush_input_buffer();
-            }
-            break;
-        case 'S':
-            // case 'S' stops PWM and disable motor system
-            if(usb_msg_length() >= MEGN540_Message_Len('S')){
-                mf_stop_PWM.active = true;
-                usb_flush_input_buffer();
-            }
-            break;
-        case 'q':
-            // case 'q' sends system identification data back to host.
-            if(usb_msg_length() >= MEGN540_Message_Len('q')){
-                // then process your q...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a q so no need to save it as a variable
-
-                mf_send_sys_info.active = true;
-                mf_send_sys_info.duration = -1;
-            }
-            break;
-        case 'Q':
-            // case 'Q' sends the system identification information back to the host every X ms (as specified in the second float).
-            // If this float is zero or negative, then the repeat send request is canceled.
-            if(usb_msg_length() >= MEGN540_Message_Len('Q')){
-                // then process your Q...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a Q so no need to save it as a variable
-
-                mf_send_sys_info.active = true;
-                float duration;
-                usb_msg_read_into(&duration, sizeof(duration));
-
-                if(duration <= 0){
-                    mf_send_sys_info.duration = -1;
-                }else{
-                    mf_send_sys_info.duration = duration;
-                }
-            }
-            break;
-        case 'd':
-            // case 'd' specifies the distance to drive (linear followed by angular).
-            if(usb_msg_length() >= MEGN540_Message_Len('d')){
-                // then process your d...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a d so no need to save it as a variable
-
-                // Build a meaningful structure to put your data in. Here we want two floats.
-                struct __attribute__((__packed__)) { float linear; float angular; } data;
-                usb_msg_read_into(&data, sizeof(data));
-
-                mf_distance_mode.active = true;
-
-                Dist_data.linear  = data.linear/1000;
-                Dist_data.angular = data.angular*3.0;
-                //Controller_Set_Target_Position(&controller,data.linear)
-            }
-            break;    
-        case 'D':
-            // case 'D' specifies the distance to drive (linear followed by angular), terminates after X milliseconds as specified by the third float.
-            // If the third float is negative, the car shall stop.
-            if(usb_msg_length() >= MEGN540_Message_Len('D')){
-                // then process your D...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a D so no need to save it as a variable
-
-                // Build a meaningful structure to put your data in. Here we want three floats.
-                struct __attribute__((__packed__)) { float linear; float angular; float duration;} data;
-                usb_msg_read_into(&data, sizeof(data));
-
-                if(data.duration < 0){
-                    mf_distance_mode.active = false;
-                    mf_stop_PWM.active = true;
-                }else{
-                    mf_stop_PWM.active = false;
-                    mf_distance_mode.active = true;
-                    mf_distance_mode.duration = data.duration/1000;
-                }
-                Dist_data.linear  = data.linear/1000;
-                Dist_data.angular = data.angular*3.0;
-            }
-            break;      
-        case 'v':
-            // case 'v' specifies the speed to drive (linear followed by angular).
-            if(usb_msg_length() >= MEGN540_Message_Len('v')){
-                // then process your v...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a v so no need to save it as a variable
-
-                // Build a meaningful structure to put your data in. Here we want two floats.
-                struct __attribute__((__packed__)) { float linear; float angular;} data;
-                usb_msg_read_into(&data, sizeof(data));
-
-                mf_velocity_mode.active = true;
-
-                Veloc_data.linear  = data.linear/1000;
-                Veloc_data.angular = data.angular;
-            } 
-            break;  
-        case 'V':
-            // case 'V' specifies the speed to drive (linear followed by angular), terminates after X milliseconds as specified by the third float.
-            // If the third float is negative, the car shall stop.
-            if(usb_msg_length() >= MEGN540_Message_Len('V')){
-                // then process your v...
-                usb_msg_get(); // removes the first character from the received buffer, we already know it was a V so no need to save it as a variable
-                
-                // Build a meaningful structure to put your data in. Here we want three floats.
-                struct __attribute__((__packed__)) { float linear; float angular; float duration;} data;
-                usb_msg_read_into(&data, sizeof(data));
-
-                if(data.duration < 0){
-                    mf_velocity_mode.active = false;
-                    mf_stop_PWM.active = true;
-                }else{
-                    mf_velocity_mode.active = true;
-                    mf_velocity_mode.duration = data.duration/1000;
-                }
-                Veloc_data.linear  = data.linear;
-                Veloc_data.angular = data.angular;
-            }
-            break;             
-        case '~':
-            if(usb_msg_length() >= MEGN540_Message_Len('~')){
-                // then process your reset by setting the mf_restart flag 
-                usb_flush_input_buffer();
-                mf_restart.active = true;
-            }
-            break;
-        default:
-            // What to do if you dont recognize the command character
-            usb_flush_input_buffer();
-            usb_send_msg("cc", '?', &command, sizeof(command));
-            break;
+    MSG_Handler_t handler = _msg_command_handler(command);
+    if(handler == NULL){
+        // What to do if you dont recognize the command character
+        usb_flush_input_buffer();
+        usb_send_msg("cc", '?', &command, sizeof(command));
+        return true;
     }
+
+    uint8_t payload_len = MEGN540_Message_Len(command) - 1;
+    if(usb_msg_length() < payload_len + 1) return false; // wait for the rest of the message
+
+    usb_msg_get(); // removes the command char from the received buffer, we already know what it was
+
+    uint8_t payload[MSG_MAX_PAYLOAD];
+    usb_msg_read_into(payload, payload_len);
+
+    handler(command, payload_len ? payload : NULL);
+    return true;
+}
+
+/**
+ * Function Message_Handler processes USB messages as necessary and sets status flags to control the flow of the program.
+ * Complete commands are processed back to back until only a partial command remains, the time budget (see
+ * Message_Handling_Set_Time_Budget) runs out, or a restart is requested.
+ */
+void Message_Handling_Task()
+{
+    PROFILE_BEGIN(PROFILE_MESSAGE_HANDLING);
+    Time_t start = GetTime();
+
+    while(_msg_process_one()){
+        if(mf_restart.active || MicrosSince(&start) >= _msg_time_budget_us) break;
+    }
+
+    Loop_Stats_Record(LOOP_STATS_MESSAGES, MicrosSince(&start));
+    PROFILE_END(PROFILE_MESSAGE_HANDLING);
 }
 
 /**
@@ -483,34 +681,6 @@ void Message_Handling_Task()
  */
 uint8_t MEGN540_Message_Len( char cmd )
 {
-    switch(cmd){
-        case '~': return	1; break;
-        case '*': return	9; break;
-        case '/': return	9; break;
-        case '+': return	9; break;
-        case '-': return	9; break;
-        case 't': return	2; break;
-        case 'T': return	6; break;
-        case 'e': return	1; break;
-        case 'E': return	5; break;
-        case 'b': return	1; break;
-        case 'B': return	5; break;
-//        case 'a': return	1; break;
-//        case 'A': return 	5; break;
-//        case 'w': return	1; break;
-//        case 'W': return 	5; break;
-//        case 'm': return	1; break;
-//        case 'M': return	5; break;
-        case 'p': return	5; break;
-        case 'P': return	9; break;
-        case 's': return 	1; break;
-        case 'S': return 	1; break;
-        case 'q': return	1; break;
-        case 'Q': return 	5; break;
-        case 'd': return 	9; break;
-        case 'D': return   13; break;
-        case 'v': return	9; break;
-        case 'V': return   13; break;
-        default:  return	0; break;
-    }
+    if(_msg_command_handler(cmd) == NULL) return 0;
+    return 1 + pgm_read_byte(&_msg_commands[(uint8_t)cmd].payload_len);
 }
@@ -47,8 +47,25 @@ typedef struct MOVE_INFO { float linear; float angular; float duration; } MOVE_I
 MOVE_INFO_t Dist_data;          ////<-- This stores data for commanded distance movement
 MOVE_INFO_t Veloc_data;         ////<-- This stores data for commanded velocity movement
 
-/** Message Driven State Machine Flags */
-typedef struct MSG_FLAG { bool active; float duration; char command; uint8_t subcommand; Time_t last_trigger_time; } MSG_FLAG_t;
+/**
+ * Message Driven State Machine Flags
+ *   period:        [ms] repeat period of a periodic stream; 0 runs the action every loop while active (one-shot
+ *                  actions clear active themselves).
+ *   next_deadline: [ms] GetMilli() time the next periodic execution is due; advanced by period on each execution
+ *                  so the stream does not drift.
+ *   missed:        number of periodic executions skipped because the main loop fell more than a period behind.
+ *   time_limit:    [ms] run-time limit of motion commands (PWM, distance, velocity); negative for none.
+ */
+typedef struct MSG_FLAG {
+    bool     active;
+    uint16_t period;
+    uint32_t next_deadline;
+    uint16_t missed;
+    int32_t  time_limit;
+    char     command;
+    uint8_t  subcommand;
+    Time_t   last_trigger_time;
+} MSG_FLAG_t;
 MSG_FLAG_t mf_restart;           ///<-- This flag indicates that the device received a restart command from the host. Default inactive.
 MSG_FLAG_t mf_loop_timer;        ///<-- Indicates if the system should report time to complete a loop.
 MSG_FLAG_t mf_time_float_send;   ///<-- Indicates if the system should report the time to send a float.
@@ -59,16 +76,48 @@ MSG_FLAG_t mf_send_voltage;      ///<-- Indicates if the system should report ba
 MSG_FLAG_t mf_set_PWM; 		     ///<-- Indicates if the system should set the PWM.
 MSG_FLAG_t mf_stop_PWM; 	     ///<-- Indicates if the system should stop PWM and disable the motor.
 MSG_FLAG_t mf_send_sys_info;     ///<-- Indicates if the system should send system identification info.
+MSG_FLAG_t mf_send_sys_batch;    ///<-- Indicates if the system should stream batched system identification info (subcommand = samples per frame).
 MSG_FLAG_t mf_distance_mode;     ///<-- Indicates if the system should move in terms of distance
 MSG_FLAG_t mf_velocity_mode;     ///<-- Indicates if the system should move in terms of velocity
 
 /**
  * Function MSG_FLAG_Execute indicates if the action associated with the message flag should be executed
- * in the main loop both because its active and because its time.
+ * in the main loop both because its active and because its time. A periodic flag's deadline is advanced by one
+ * period each time this returns true; whole periods that already passed are skipped and counted in missed.
  * @return [bool] True for execute action, False for skip action
  */
 bool MSG_FLAG_Execute( MSG_FLAG_t* );
 
+/**
+ * Function MSG_FLAG_Set_Period activates a flag as a periodic stream. The first execution is due one period from now.
+ * @param p_flag [MSG_FLAG_t*] flag to activate
+ * @param period_ms [uint16_t] repeat period in milliseconds, 0 for a one-shot
+ */
+void MSG_FLAG_Set_Period( MSG_FLAG_t* p_flag, uint16_t period_ms );
+
+/**
+ * Function MSG_Scheduler_Add registers a task to run whenever its flag is due. Registered tasks are run by
+ * MSG_Scheduler_Run, earliest deadline first.
+ * @param p_flag [MSG_FLAG_t*] flag controlling the task
+ * @param task [MSG_Task_t] function to run, it receives the flag (e.g. to read command or clear active)
+ * @return [bool] False if MSG_SCHEDULER_MAX_TASKS tasks are already registered
+ */
+#define MSG_SCHEDULER_MAX_TASKS 8
+typedef void (*MSG_Task_t)( MSG_FLAG_t* p_flag );
+bool MSG_Scheduler_Add( MSG_FLAG_t* p_flag, MSG_Task_t task );
+
+/**
+ * Function MSG_Scheduler_Run runs every registered task whose flag is due, in order of deadline.
+ */
+void MSG_Scheduler_Run();
+
+/**
+ * Function MSG_Scheduler_Missed returns the total number of missed periodic deadlines of the registered tasks.
+ * @param reset [bool] zero the counters after reading them
+ * @return [uint16_t] missed deadlines
+ */
+uint16_t MSG_Scheduler_Missed( bool reset );
+
 /**
  * Function Message_Handling_Init initializes the message handling and all associated state flags and data to their default
  * conditions.
@@ -77,11 +126,18 @@ void Message_Handling_Init();
 
 /**
  * Function Message_Handler processes USB messages as necessary and sets status flags to control the flow of the program.
- * It returns true unless the program receives a reset message.
- * @return
+ * Every complete command in the receive buffer is processed, until the per-call time budget runs out.
  */
 void Message_Handling_Task();
 
+/**
+ * Function Message_Handling_Set_Time_Budget sets how long one call to Message_Handling_Task may keep processing
+ * commands (default MSG_DEFAULT_TIME_BUDGET). At least one complete command is always processed.
+ * @param budget_us [uint32_t] time budget per call in microseconds, zero processes one command per call
+ */
+#define MSG_DEFAULT_TIME_BUDGET 1000 // [us]
+void Message_Handling_Set_Time_Budget(uint32_t budget_us);
+
 /**
  * Function MEGN540_Message_Len returns the number of bytes associated with a command string per the
  * class documentation;
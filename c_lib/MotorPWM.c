@@ -1,5 +1,7 @@
 #include "MotorPWM.h"
 
+#include <util/atomic.h> // PWM registers are also written from the control tick ISR
+
 static bool motor_enabled = false;
 
 /**
@@ -74,9 +76,11 @@ bool Is_Motor_PWM_Enabled() {
  * @return [int32_t] The count number.
  */
 void Motor_PWM_Left( int16_t pwm ) {
-    // (Sec. 14.10.10)
-    OCR1BL = ((uint16_t) pwm) & 0xFF;
-    OCR1BH = (((uint16_t) pwm) >> 8) & 0xFF;
+    // (Sec. 14.10.10) 16-bit write through the TEMP register (high byte first), kept atomic since the
+    // control tick ISR (Control_Tick.h) also sets the PWM
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        OCR1B = (uint16_t) pwm;
+    }
 }
 
 /**
@@ -84,9 +88,11 @@ void Motor_PWM_Left( int16_t pwm ) {
  * @return [int32_t] The count number.
  */
 void Motor_PWM_Right( int16_t pwm ) {
-    // (Sec. 14.10.9)
-    OCR1AL = ((uint16_t) pwm) & 0xFF;
-    OCR1AH = (((uint16_t) pwm) >> 8) & 0xFF;
+    // (Sec. 14.10.9) 16-bit write through the TEMP register (high byte first), kept atomic since the
+    // control tick ISR (Control_Tick.h) also sets the PWM
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        OCR1A = (uint16_t) pwm;
+    }
 }
 
 /**
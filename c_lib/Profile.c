@@ -0,0 +1,109 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Profile.h"
+
+static Profile_Entry_t _profile_table[PROFILE_COUNT] = { [0 ... PROFILE_COUNT - 1] = { .min = 0xFFFF } };
+
+/**
+ * Function Profile_Init starts Timer3 free-running at the CPU clock if nothing has started it yet, and clears
+ * the table.
+ */
+void Profile_Init()
+{
+    // Same normal mode, no prescaler setup as Control_Tick_Init (Sec. 14.10.1 & 14.10.3)
+    if( (TCCR3B & ((1 << CS32) | (1 << CS31) | (1 << CS30))) == 0 ){
+        TCCR3A = 0;
+        TCCR3B = (1 << CS30);
+    }
+
+    Profile_Reset();
+}
+
+/**
+ * Function Profile_Add adds one pass of a section to the table. Used by PROFILE_END; safe from interrupts.
+ * @param id [Profile_Id_t] section
+ * @param cycles [uint16_t] length of the pass
+ */
+void Profile_Add( Profile_Id_t id, uint16_t cycles )
+{
+    if( id >= PROFILE_COUNT ) return;
+
+    // Sections such as Filter_Value run both in the main loop and in the control tick ISR
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        Profile_Entry_t* p_entry = &_profile_table[id];
+
+        p_entry->calls++;
+        p_entry->cycles = (p_entry->cycles > UINT32_MAX - cycles) ? UINT32_MAX : p_entry->cycles + cycles;
+        if( cycles < p_entry->min ){
+            p_entry->min = cycles;
+        }
+        if( cycles > p_entry->max ){
+            p_entry->max = cycles;
+        }
+    }
+}
+
+/**
+ * Function Profile_Get copies out a section's entry.
+ * @param id [Profile_Id_t] section
+ * @param p_entry [Profile_Entry_t*] filled with the section's totals
+ * @return [bool] false if id is not a section
+ */
+bool Profile_Get( Profile_Id_t id, Profile_Entry_t* p_entry )
+{
+    if( id >= PROFILE_COUNT ) return false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        *p_entry = _profile_table[id];
+    }
+
+    p_entry->id = id;
+    // Report 0 rather than the empty-table sentinel
+    if( p_entry->calls == 0 ){
+        p_entry->min = 0;
+    }
+    return true;
+}
+
+/**
+ * Function Profile_Reset clears the table.
+ */
+void Profile_Reset()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        for( uint8_t i = 0; i < PROFILE_COUNT; i++ ){
+            _profile_table[i].calls  = 0;
+            _profile_table[i].cycles = 0;
+            _profile_table[i].min    = 0xFFFF;
+            _profile_table[i].max    = 0;
+        }
+    }
+}
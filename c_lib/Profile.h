@@ -0,0 +1,130 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Profile.h/c is a cycle-count profiler for named code sections. Wrap a section with
+ *
+ *     PROFILE_BEGIN(PROFILE_FILTER_VALUE);
+ *     ...
+ *     PROFILE_END(PROFILE_FILTER_VALUE);
+ *
+ * and every pass adds its length in CPU cycles to that section's entry (calls, total, min, max). The 'f' command
+ * dumps the table and 'F' dumps then clears it.
+ *
+ * Cycles are read from Timer3, free-running at the CPU clock (62.5 ns per count at 16 MHz; Timer0's 4 us is far
+ * too coarse for these sections). Control_Tick_Init or Profile_Init starts it. The count is 16 bits, so sections
+ * must be shorter than 65536 cycles (4 ms). The numbers include the few cycles of the markers themselves.
+ *
+ * The markers only exist when PROFILE_ENABLE is defined (cmake -DPROFILE_ENABLE=ON). Otherwise they compile to
+ * nothing and the table stays empty.
+ */
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <avr/io.h>        // for TCNT3
+#include <stdint.h>
+#include <stdbool.h>
+#include <util/atomic.h>   // TCNT3 reads go through the shared TEMP register
+
+/**
+ * Profiled sections. Add new ones before PROFILE_COUNT.
+ */
+typedef enum {
+    PROFILE_FILTER_VALUE,
+    PROFILE_FILTER_FIXED_VALUE,
+    PROFILE_FILTER_SOS_VALUE,
+    PROFILE_CONTROLLER_UPDATE,
+    PROFILE_BATTERY_VOLTAGE,
+    PROFILE_MESSAGE_HANDLING,
+    PROFILE_ENCODER_LEFT_ISR,
+    PROFILE_ENCODER_RIGHT_ISR,
+    PROFILE_FILTER_MULTI_VALUE,
+    PROFILE_COUNT
+} Profile_Id_t;
+
+/**
+ * Accumulated cycles for one section, as sent by the 'f'/'F' commands.
+ */
+typedef struct __attribute__((__packed__)) {
+    uint8_t  id;
+    uint32_t calls;
+    uint32_t cycles;    // total, saturates at 2^32-1
+    uint16_t min;
+    uint16_t max;
+} Profile_Entry_t;
+
+#ifdef PROFILE_ENABLE
+#define PROFILE_BEGIN(id) uint16_t _profile_start_##id = Profile_Now()
+#define PROFILE_END(id)   Profile_Add((id), Profile_Now() - _profile_start_##id)
+#else
+#define PROFILE_BEGIN(id) do{}while(0)
+#define PROFILE_END(id)   do{}while(0)
+#endif
+
+/**
+ * Function Profile_Now returns the Timer3 count.
+ * @return [uint16_t] CPU cycles, modulo 2^16
+ */
+static inline uint16_t Profile_Now()
+{
+    uint16_t now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        now = TCNT3;
+    }
+    return now;
+}
+
+/**
+ * Function Profile_Init starts Timer3 free-running at the CPU clock if nothing has started it yet, and clears
+ * the table.
+ */
+void Profile_Init();
+
+/**
+ * Function Profile_Add adds one pass of a section to the table. Used by PROFILE_END; safe from interrupts.
+ * @param id [Profile_Id_t] section
+ * @param cycles [uint16_t] length of the pass
+ */
+void Profile_Add( Profile_Id_t id, uint16_t cycles );
+
+/**
+ * Function Profile_Get copies out a section's entry.
+ * @param id [Profile_Id_t] section
+ * @param p_entry [Profile_Entry_t*] filled with the section's totals
+ * @return [bool] false if id is not a section
+ */
+bool Profile_Get( Profile_Id_t id, Profile_Entry_t* p_entry );
+
+/**
+ * Function Profile_Reset clears the table.
+ */
+void Profile_Reset();
+
+#endif
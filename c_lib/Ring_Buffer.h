@@ -30,16 +30,25 @@
 
 /* Ring_Buffer.h
  *
- * This set of functions enables a ringbuffer for both float and char data types.
- * A ring buffer allows constant data addition and removal in a fixed size array.
- * The ring buffer will overwrite existing elements of the array if more data is
- * added than there is adequate space. This works well for a First in First Out
- * or Last in First Out type queue.
+ * This set of functions enables a ringbuffer for any element type. A ring buffer allows
+ * constant data addition and removal in a fixed size array. The ring buffer will overwrite
+ * existing elements of the array if more data is added than there is adequate space. This
+ * works well for a First in First Out or Last in First Out type queue.
  *
- * Functions implemented are as follows (where X is either F or C to denote float or char):
+ * Each ring buffer type is generated by a pair of macros so the element type, the capacity
+ * (a power of 2) and the index width can be chosen per use:
+ *
+ *     RB_DECLARE( X, TYPE, LENGTH, INDEX_T )  <-- in a header (or .c), declares struct Ring_Buffer_X and its functions
+ *     RB_DEFINE ( X, TYPE, LENGTH, INDEX_T )  <-- in exactly one .c file, defines the functions
+ *
+ * INDEX_T must be able to count to LENGTH-1, so uint8_t covers up to 256 elements and
+ * uint16_t is needed beyond that. Both conditions are checked at compile time.
+ *
+ * Functions implemented are as follows (where X is the suffix chosen in RB_DECLARE, F and C
+ * are provided here for float and char):
  *
  * Ring_Buffer_X    <-- The internal data structure for the ringbuffer object
- * rb_print_data_X  <-- Prints debugging information to the terminal assist with code generation and capabilities
+ * rb_print_data_X  <-- Prints debugging information to the terminal assist with code generation and capabilities (F and C only)
  * rb_initialize_X  <-- Initializes the ring buffer for use.
  * rb_length_X      <-- Returns the number of active elements in the ringbuffer
  * rb_push_back_X   <-- Appends an element to the end of the buffer
@@ -48,6 +57,28 @@
  * rb_pop_front_X   <-- Removes and returns the first element
  * rb_get_X         <-- Returns an desired element from within the buffer
  * rb_set_X         <-- Sets a desired element within the buffer
+ * rb_free_X        <-- Returns the number of elements that can be added without overwriting
+ *
+ * The contiguous-region (span) functions hand out pointers straight into the backing array so
+ * blocks can be moved with memcpy or decoded in place. A region never wraps, so a full transfer
+ * takes at most two reserve/peek calls.
+ *
+ * rb_write_reserve_X       <-- Points at the longest free run starting offset elements past the end
+ * rb_write_commit_X        <-- Appends count elements previously written into reserved space
+ * rb_read_peek_contiguous_X<-- Points at the longest active run starting offset elements past the start
+ * rb_read_consume_X        <-- Removes count elements from the start
+ *
+ * A single-producer/single-consumer variant is generated by RB_SPSC_DECLARE/RB_SPSC_DEFINE for
+ * buffers shared between an ISR and the main loop. The producer only ever writes end_index and the
+ * consumer only ever writes start_index, both are single bytes (atomic on the AVR) and published
+ * behind a compiler barrier, so neither side needs to disable interrupts. A full SPSC buffer
+ * rejects new elements rather than overwriting, since moving start_index from the producer side
+ * would race with the consumer.
+ *
+ * rb_initialize_X  <-- Initializes the ring buffer for use (before either side runs).
+ * rb_length_X      <-- Returns the number of active elements (a snapshot, safe from either side)
+ * rb_push_back_X   <-- Producer only. Appends an element, returns false if full
+ * rb_pop_front_X   <-- Consumer only. Removes the first element into *p_value, returns false if empty
  *
  * Code Skeleton provided by Dr Petruska for MEGN 540, Mechatronics
  * Code Details Provided by:  [ YOUR NAME ]
@@ -57,67 +88,260 @@
 #define RING_BUFFER_H
 
 #include "stdint.h" // for uint8_t type
+#include <stdbool.h> // for bool type
 
 #define RB_LENGTH_F 8  // must be a power of 2 (max of 256). This is an easy place to adjust max expected length
 #define RB_LENGTH_C 64  // must be a power of 2 (max of 256). This is an easy place to adjust max expected length
 
-// data structure for a float ring buffer 
-typedef struct Ring_Buffer_F
-{
-    float buffer[RB_LENGTH_F];
-    uint8_t start_index;
-    uint8_t end_index;
-} Ring_Buffer_F_t;
-
-// data structure for a char ring buffer
-typedef struct Ring_Buffer_C
-{
-    char buffer[RB_LENGTH_C];
-    uint8_t start_index;
-    uint8_t end_index;
-} Ring_Buffer_C_t;
-
-// Debugging Assistant Functions (these are already written for you)
-void rb_print_data_F(struct Ring_Buffer_F *p_buf);
-void rb_print_data_C(struct Ring_Buffer_C *p_buf);
-
+/**
+ * Macro RB_DECLARE declares the data structure and function prototypes for a ring buffer holding
+ * LENGTH elements of TYPE indexed by INDEX_T.  The functions are named rb_<function>_SUFFIX.
+ */
+#define RB_DECLARE( SUFFIX, TYPE, LENGTH, INDEX_T )                                                     \
+    _Static_assert( (LENGTH) > 1 && ((LENGTH) & ((LENGTH) - 1)) == 0,                                  \
+                    "Ring_Buffer_" #SUFFIX " length must be a power of 2" );                            \
+    _Static_assert( (unsigned long)(LENGTH) - 1 <= (INDEX_T)(~(INDEX_T)0),                              \
+                    "Ring_Buffer_" #SUFFIX " index type is too small for its length" );                 \
+                                                                                                        \
+    typedef struct Ring_Buffer_##SUFFIX                                                                 \
+    {                                                                                                   \
+        TYPE buffer[LENGTH];                                                                            \
+        INDEX_T start_index;                                                                            \
+        INDEX_T end_index;                                                                              \
+    } Ring_Buffer_##SUFFIX##_t;                                                                         \
+                                                                                                        \
+    void    rb_initialize_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf );                               \
+    INDEX_T rb_length_##SUFFIX    ( const struct Ring_Buffer_##SUFFIX* p_buf );                         \
+    void    rb_push_back_##SUFFIX ( struct Ring_Buffer_##SUFFIX* p_buf, TYPE value );                   \
+    void    rb_push_front_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, TYPE value );                   \
+    TYPE    rb_pop_back_##SUFFIX  ( struct Ring_Buffer_##SUFFIX* p_buf );                               \
+    TYPE    rb_pop_front_##SUFFIX ( struct Ring_Buffer_##SUFFIX* p_buf );                               \
+    TYPE    rb_get_##SUFFIX       ( const struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T index );          \
+    void    rb_set_##SUFFIX       ( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T index, TYPE value );    \
+    INDEX_T rb_free_##SUFFIX      ( const struct Ring_Buffer_##SUFFIX* p_buf );                         \
+    INDEX_T rb_write_reserve_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T offset,              \
+                                       TYPE** pp_region );                                              \
+    void    rb_write_commit_##SUFFIX ( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T count );             \
+    INDEX_T rb_read_peek_contiguous_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T offset,       \
+                                              TYPE** pp_region );                                       \
+    void    rb_read_consume_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T count )
 
-/****** Functions   **********/
+/**
+ * Macro RB_DEFINE defines the functions declared by RB_DECLARE with the same arguments. Use it in
+ * exactly one .c file per SUFFIX.
+ */
+#define RB_DEFINE( SUFFIX, TYPE, LENGTH, INDEX_T )                                                      \
+    /* Initialization */                                                                                \
+    void rb_initialize_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf )                                   \
+    {                                                                                                   \
+        /* set start and end indicies to 0, no point changing data */                                   \
+        p_buf->start_index = 0;                                                                         \
+        p_buf->end_index = 0;                                                                           \
+    }                                                                                                   \
+                                                                                                        \
+    /* Return active Length of Buffer */                                                                \
+    INDEX_T rb_length_##SUFFIX( const struct Ring_Buffer_##SUFFIX* p_buf )                              \
+    {                                                                                                   \
+        /* the mask and 2's complement handle the wrap around */                                        \
+        return (p_buf->end_index - p_buf->start_index) & ((LENGTH) - 1);                                \
+    }                                                                                                   \
+                                                                                                        \
+    /* Append element to end and lengthen, the oldest element is dropped if full */                     \
+    void rb_push_back_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, TYPE value )                        \
+    {                                                                                                   \
+        p_buf->buffer[p_buf->end_index] = value;                                                        \
+        p_buf->end_index = (p_buf->end_index + 1) & ((LENGTH) - 1);                                     \
+                                                                                                        \
+        if( p_buf->start_index == p_buf->end_index ){                                                   \
+            p_buf->start_index = (p_buf->start_index + 1) & ((LENGTH) - 1);                             \
+        }                                                                                               \
+    }                                                                                                   \
+                                                                                                        \
+    /* Append element to front and lengthen, the newest element is dropped if full */                   \
+    void rb_push_front_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, TYPE value )                       \
+    {                                                                                                   \
+        p_buf->start_index = (p_buf->start_index - 1) & ((LENGTH) - 1);                                 \
+                                                                                                        \
+        if( p_buf->end_index == p_buf->start_index ){                                                   \
+            p_buf->end_index = (p_buf->end_index - 1) & ((LENGTH) - 1);                                 \
+        }                                                                                               \
+                                                                                                        \
+        p_buf->buffer[p_buf->start_index] = value;                                                      \
+    }                                                                                                   \
+                                                                                                        \
+    /* Remove element from end and shorten, returns zero if empty */                                    \
+    TYPE rb_pop_back_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf )                                     \
+    {                                                                                                   \
+        if( p_buf->end_index != p_buf->start_index ){                                                   \
+            p_buf->end_index = (p_buf->end_index - 1) & ((LENGTH) - 1);                                 \
+            return p_buf->buffer[p_buf->end_index];                                                     \
+        }                                                                                               \
+                                                                                                        \
+        return 0;                                                                                       \
+    }                                                                                                   \
+                                                                                                        \
+    /* Remove element from start and shorten, returns zero if empty */                                  \
+    TYPE rb_pop_front_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf )                                    \
+    {                                                                                                   \
+        if( p_buf->end_index != p_buf->start_index ){                                                   \
+            TYPE hold = p_buf->buffer[p_buf->start_index];                                              \
+            p_buf->start_index = (p_buf->start_index + 1) & ((LENGTH) - 1);                             \
+            return hold;                                                                                \
+        }                                                                                               \
+                                                                                                        \
+        return 0;                                                                                       \
+    }                                                                                                   \
+                                                                                                        \
+    /* access element */                                                                                \
+    TYPE rb_get_##SUFFIX( const struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T index )                     \
+    {                                                                                                   \
+        return p_buf->buffer[(p_buf->start_index + index) & ((LENGTH) - 1)];                            \
+    }                                                                                                   \
+                                                                                                        \
+    /* set element - This behavior is poorly defined if index is outside of active length. */          \
+    void rb_set_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T index, TYPE value )               \
+    {                                                                                                   \
+        p_buf->buffer[(p_buf->start_index + index) & ((LENGTH) - 1)] = value;                           \
+    }                                                                                                   \
+                                                                                                        \
+    /* Number of elements that can be appended before the oldest is overwritten */                      \
+    INDEX_T rb_free_##SUFFIX( const struct Ring_Buffer_##SUFFIX* p_buf )                                \
+    {                                                                                                   \
+        return ((LENGTH) - 1) - rb_length_##SUFFIX( p_buf );                                            \
+    }                                                                                                   \
+                                                                                                        \
+    /* Longest free run starting offset past the end, *pp_region points at it. Nothing is appended     \
+       until rb_write_commit is called, so the reserved data is invisible to readers until then. */    \
+    INDEX_T rb_write_reserve_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T offset,              \
+                                       TYPE** pp_region )                                               \
+    {                                                                                                   \
+        INDEX_T free_count = rb_free_##SUFFIX( p_buf );                                                 \
+        if( offset >= free_count ) return 0;                                                            \
+                                                                                                        \
+        INDEX_T  position = (p_buf->end_index + offset) & ((LENGTH) - 1);                               \
+        uint16_t run      = (uint16_t)(LENGTH) - position;                                              \
+        if( run > (uint16_t)(free_count - offset) ) run = free_count - offset;                          \
+                                                                                                        \
+        /* Formed from the byte address: the struct is packed, and AVR has no alignment requirement */  \
+        *pp_region = (TYPE*)( (uint8_t*)p_buf->buffer + position * sizeof(TYPE) );                      \
+        return run;                                                                                     \
+    }                                                                                                   \
+                                                                                                        \
+    /* Append count elements that were written into reserved space */                                   \
+    void rb_write_commit_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T count )                  \
+    {                                                                                                   \
+        p_buf->end_index = (p_buf->end_index + count) & ((LENGTH) - 1);                                 \
+    }                                                                                                   \
+                                                                                                        \
+    /* Longest active run starting offset past the start, *pp_region points at it (may be modified) */ \
+    INDEX_T rb_read_peek_contiguous_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T offset,       \
+                                              TYPE** pp_region )                                        \
+    {                                                                                                   \
+        INDEX_T length = rb_length_##SUFFIX( p_buf );                                                   \
+        if( offset >= length ) return 0;                                                                \
+                                                                                                        \
+        INDEX_T  position = (p_buf->start_index + offset) & ((LENGTH) - 1);                             \
+        uint16_t run      = (uint16_t)(LENGTH) - position;                                              \
+        if( run > (uint16_t)(length - offset) ) run = length - offset;                                  \
+                                                                                                        \
+        /* Formed from the byte address: the struct is packed, and AVR has no alignment requirement */  \
+        *pp_region = (TYPE*)( (uint8_t*)p_buf->buffer + position * sizeof(TYPE) );                      \
+        return run;                                                                                     \
+    }                                                                                                   \
+                                                                                                        \
+    /* Remove count elements from the start (clipped to the active length) */                           \
+    void rb_read_consume_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, INDEX_T count )                  \
+    {                                                                                                   \
+        INDEX_T length = rb_length_##SUFFIX( p_buf );                                                   \
+        if( count > length ) count = length;                                                            \
+        p_buf->start_index = (p_buf->start_index + count) & ((LENGTH) - 1);                             \
+    }
 
-/* Initialization */
-void rb_initialize_F( struct Ring_Buffer_F* p_buf );
-void rb_initialize_C( struct Ring_Buffer_C* p_buf );
 
-/* Return active Length of Buffer */
-uint8_t rb_length_F( const struct Ring_Buffer_F* p_buf);
-uint8_t rb_length_C( const struct Ring_Buffer_C* p_buf);
+/**
+ * Macro RB_COMPILER_BARRIER keeps the compiler from moving memory accesses across it. On the single
+ * core AVR this is all that is needed to order a data write before the index that publishes it.
+ */
+#define RB_COMPILER_BARRIER() __asm__ __volatile__( "" ::: "memory" )
 
-/* Append element to end and lengthen */
-void rb_push_back_F( struct Ring_Buffer_F* p_buf, float value);
-void rb_push_back_C( struct Ring_Buffer_C* p_buf, char value);
+/**
+ * Macro RB_SPSC_DECLARE declares a single-producer/single-consumer ring buffer holding up to LENGTH-1
+ * elements of TYPE.  Indices are always uint8_t so every publish is a single byte store.
+ */
+#define RB_SPSC_DECLARE( SUFFIX, TYPE, LENGTH )                                                         \
+    _Static_assert( (LENGTH) > 1 && ((LENGTH) & ((LENGTH) - 1)) == 0 && (LENGTH) <= 256,                \
+                    "Ring_Buffer_" #SUFFIX " length must be a power of 2 no larger than 256" );        \
+                                                                                                        \
+    typedef struct Ring_Buffer_##SUFFIX                                                                 \
+    {                                                                                                   \
+        TYPE buffer[LENGTH];                                                                            \
+        volatile uint8_t start_index; /* written by the consumer only */                                \
+        volatile uint8_t end_index;   /* written by the producer only */                                \
+    } Ring_Buffer_##SUFFIX##_t;                                                                         \
+                                                                                                        \
+    void    rb_initialize_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf );                               \
+    uint8_t rb_length_##SUFFIX    ( const struct Ring_Buffer_##SUFFIX* p_buf );                         \
+    bool    rb_push_back_##SUFFIX ( struct Ring_Buffer_##SUFFIX* p_buf, TYPE value );                   \
+    bool    rb_pop_front_##SUFFIX ( struct Ring_Buffer_##SUFFIX* p_buf, TYPE* p_value )
 
-/* Append element to front and lengthen */
-void rb_push_front_F( struct Ring_Buffer_F* p_buf, float value);
-void rb_push_front_C( struct Ring_Buffer_C* p_buf, char value);
+/**
+ * Macro RB_SPSC_DEFINE defines the functions declared by RB_SPSC_DECLARE with the same arguments.
+ */
+#define RB_SPSC_DEFINE( SUFFIX, TYPE, LENGTH )                                                          \
+    /* Initialization, call before the producer or consumer are running */                             \
+    void rb_initialize_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf )                                   \
+    {                                                                                                   \
+        p_buf->start_index = 0;                                                                         \
+        p_buf->end_index = 0;                                                                           \
+    }                                                                                                   \
+                                                                                                        \
+    /* Return active Length of Buffer, each index is read once so the result is a consistent snapshot */\
+    uint8_t rb_length_##SUFFIX( const struct Ring_Buffer_##SUFFIX* p_buf )                              \
+    {                                                                                                   \
+        uint8_t start = p_buf->start_index;                                                             \
+        uint8_t end   = p_buf->end_index;                                                               \
+        return (end - start) & ((LENGTH) - 1);                                                          \
+    }                                                                                                   \
+                                                                                                        \
+    /* Producer: store the element, then publish it by moving end_index */                             \
+    bool rb_push_back_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, TYPE value )                        \
+    {                                                                                                   \
+        uint8_t end  = p_buf->end_index;                                                                \
+        uint8_t next = (end + 1) & ((LENGTH) - 1);                                                      \
+                                                                                                        \
+        if( next == p_buf->start_index ) return false; /* full, never overwrite */                      \
+                                                                                                        \
+        p_buf->buffer[end] = value;                                                                     \
+        RB_COMPILER_BARRIER();                                                                          \
+        p_buf->end_index = next;                                                                        \
+        return true;                                                                                    \
+    }                                                                                                   \
+                                                                                                        \
+    /* Consumer: copy the element out, then release its slot by moving start_index */                  \
+    bool rb_pop_front_##SUFFIX( struct Ring_Buffer_##SUFFIX* p_buf, TYPE* p_value )                     \
+    {                                                                                                   \
+        uint8_t start = p_buf->start_index;                                                             \
+                                                                                                        \
+        if( start == p_buf->end_index ) return false; /* empty */                                       \
+                                                                                                        \
+        RB_COMPILER_BARRIER();                                                                          \
+        *p_value = p_buf->buffer[start];                                                                \
+        RB_COMPILER_BARRIER();                                                                          \
+        p_buf->start_index = (start + 1) & ((LENGTH) - 1);                                              \
+        return true;                                                                                    \
+    }
 
-/* Remove element from end and shorten */
-float rb_pop_back_F( struct Ring_Buffer_F* p_buf);
-char  rb_pop_back_C( struct Ring_Buffer_C* p_buf);
 
-/* Remove element from start and shorten */
-float rb_pop_front_F( struct Ring_Buffer_F* p_buf);
-char  rb_pop_front_C( struct Ring_Buffer_C* p_buf);
+/****** Ring Buffer Types **********/
 
-/* access element */
-float rb_get_F( const struct Ring_Buffer_F* p_buf, uint8_t index);
-char  rb_get_C( const struct Ring_Buffer_C* p_buf, uint8_t index);
+// data structure and functions for a float ring buffer (used by the filters)
+RB_DECLARE( F, float, RB_LENGTH_F, uint8_t );
 
-/* set element - This behavior is 
-   poorly defined if index is outside of active length.
-   Use of the push_back or push_front methods are preferred.
-*/
-void  rb_set_F( struct Ring_Buffer_F* p_buf, uint8_t index, float value);
-void  rb_set_C( struct Ring_Buffer_C* p_buf, uint8_t index, char value);
+// data structure and functions for a char ring buffer
+RB_DECLARE( C, char, RB_LENGTH_C, uint8_t );
 
+// Debugging Assistant Functions (these are already written for you)
+void rb_print_data_F(struct Ring_Buffer_F *p_buf);
+void rb_print_data_C(struct Ring_Buffer_C *p_buf);
 
 #endif
@@ -59,9 +59,29 @@
 #include "SerialIO.h"
 
 // *** MEGN540  ***
+// The send buffer gets its own ring buffer type so it can be sized for telemetry bursts independently
+// of RB_LENGTH_C (must be a power of 2, uint8_t indices cover up to 256).
+#define USB_SEND_BUFFER_LENGTH 256
+RB_DECLARE( TX, char, USB_SEND_BUFFER_LENGTH, uint8_t );
+RB_DEFINE ( TX, char, USB_SEND_BUFFER_LENGTH, uint8_t );
+
 // Ring Buffer Objects
-static struct Ring_Buffer_C _usb_receive_buffer;
-static struct Ring_Buffer_C _usb_send_buffer;
+static struct Ring_Buffer_C  _usb_receive_buffer;
+static struct Ring_Buffer_TX _usb_send_buffer;
+
+// Set when the last IN packet was full, the host needs a zero length packet to close the transfer
+static bool _usb_zlp_pending = false;
+
+// What to do when a buffer is full, and how often that happened
+static USB_Full_Policy_t  _usb_send_policy    = USB_FULL_REJECT_FRAME;
+static USB_Full_Policy_t  _usb_receive_policy = USB_FULL_REJECT;
+static USB_Buffer_Stats_t _usb_send_stats;
+static USB_Buffer_Stats_t _usb_receive_stats;
+
+// Registered format strings (index = format ID) and which of them the host has been told about
+static char*    _usb_formats[USB_FORMAT_MAX];
+static uint8_t  _usb_format_count     = 0;
+static uint32_t _usb_format_announced = 0;
 
 Time_t start;
 
@@ -87,14 +107,14 @@ void USB_Upkeep_Task()
     start = GetTime();
 
     if(USB_DeviceState != DEVICE_STATE_Configured) return;
-    // Get next byte from the USB hardware, send next byte to the USB hardware
-    usb_read_next_byte();
+    // Drain everything the host has sent (up to free buffer space), send next byte to the USB hardware
+    usb_read_bulk();
 
     if(MSG_FLAG_Execute(&mf_time_out)){
             usb_flush_input_buffer(); // reinitialize everything
         }
 
-    usb_write_next_byte();
+    usb_write_bulk();
 }
 
 /** Configures the board hardware and chip peripherals for the demo's functionality. */
@@ -115,7 +135,9 @@ void USB_SetupHardware(void)
 	// *** MEGN540  ***
 	// INITIALIZE RING BUFFERS AND OTHER DATA
     rb_initialize_C(&_usb_receive_buffer);
-	rb_initialize_C(&_usb_send_buffer);
+	rb_initialize_TX(&_usb_send_buffer);
+    _usb_zlp_pending = false;
+    usb_reset_buffer_stats();
 }
 
 /** Event handler for the USB_Connect event. This indicates that the device is enumerating via the status LEDs and
@@ -271,6 +293,58 @@ void usb_read_next_byte()
     }
 }
 
+/**
+ * (non-blocking) Function usb_read_bulk moves every byte waiting in the CDC OUT endpoint into the receive
+ * ring buffer in one pass, limited to the free space in the ring buffer. Bytes that do not fit stay in the
+ * endpoint (the host is NAK'd) and are collected on the next call, so nothing is overwritten.
+ * @return [uint8_t] Number of bytes moved into the receive buffer.
+ */
+uint8_t usb_read_bulk()
+{
+    /* Device must be connected and configured for the task to run */
+    if(USB_DeviceState != DEVICE_STATE_Configured) return 0;
+
+    /* Select the Serial Rx Endpoint */
+    Endpoint_SelectEndpoint(CDC_RX_EPADDR);
+
+    /* Nothing to do until the host has delivered a packet */
+    if(!Endpoint_IsOUTReceived()) return 0;
+
+    // Under the overwrite policy the whole packet is taken, making room by dropping the oldest bytes
+    uint8_t free_count = rb_free_C(&_usb_receive_buffer);
+    if(_usb_receive_policy == USB_FULL_OVERWRITE && Endpoint_BytesInEndpoint() > free_count){
+        uint8_t overwrite = Endpoint_BytesInEndpoint() - free_count;
+        rb_read_consume_C(&_usb_receive_buffer, overwrite);
+        _usb_receive_stats.dropped_bytes += overwrite;
+    }
+
+    // Read straight into the free space of the ring buffer (at most two contiguous regions), bytes are
+    // only committed once read. Otherwise anything that does not fit waits in the endpoint for the next call.
+    uint8_t moved = 0;
+    char*   p_region;
+    uint8_t run;
+
+    while(Endpoint_BytesInEndpoint() && (run = rb_write_reserve_C(&_usb_receive_buffer, moved, &p_region))){
+        uint8_t i = 0;
+        while(i < run && Endpoint_BytesInEndpoint()){
+            p_region[i++] = Endpoint_Read_8();
+        }
+        moved += i;
+    }
+    rb_write_commit_C(&_usb_receive_buffer, moved);
+
+    if(rb_length_C(&_usb_receive_buffer) > _usb_receive_stats.high_water){
+        _usb_receive_stats.high_water = rb_length_C(&_usb_receive_buffer);
+    }
+
+    /* Packet fully read, release the endpoint bank so the host can send the next one */
+    if(!Endpoint_BytesInEndpoint()){
+        Endpoint_ClearOUT();
+    }
+
+    return moved;
+}
+
 /**
  * (non-blocking) Function usb_write_next_byte takes the next byte from the output
  * ringbuffer and writes it to the USB port (if free).
@@ -306,23 +380,72 @@ void usb_write_next_byte()
     //         Endpoint_ClearIN();
     //     }
     // }
-    if(Endpoint_IsINReady() && rb_length_C(&_usb_send_buffer) != 0){
+    if(Endpoint_IsINReady() && rb_length_TX(&_usb_send_buffer) != 0){
         uint8_t space_left = CDC_TXRX_EPSIZE;
-        while(space_left && rb_length_C(&_usb_send_buffer)){
-            Endpoint_Write_8( rb_pop_front_C(&_usb_send_buffer) );
+        while(space_left && rb_length_TX(&_usb_send_buffer)){
+            Endpoint_Write_8( rb_pop_front_TX(&_usb_send_buffer) );
             space_left--;
         }
         // If we have no more to send, send a done command to the machine
         Endpoint_ClearIN();
 
-        if(space_left == 0){
-            // Wait until the endpoint is ready for the next packet
-            Endpoint_WaitUntilReady();
+        // A full packet needs a zero length packet behind it, usb_write_bulk sends it once the bank frees up
+        _usb_zlp_pending = (space_left == 0);
+    }
+}
+
+/**
+ * (non-blocking) Function usb_write_bulk moves as much of the send ring buffer as fits into one IN packet,
+ * copying contiguous runs of the ring buffer straight into the endpoint. It never waits on the endpoint:
+ * if the bank is still owned by the host it returns and tries again next call. When a transfer ends on a
+ * full CDC_TXRX_EPSIZE packet, a zero length packet is owed to the host; that is tracked in _usb_zlp_pending
+ * and sent on a later call once the bank is free and nothing else is queued.
+ * @return [uint8_t] Number of bytes written to the endpoint.
+ */
+uint8_t usb_write_bulk()
+{
+    /* Device must be connected and configured for the task to run */
+    if(USB_DeviceState != DEVICE_STATE_Configured) return 0;
+
+    /* Select the Serial Tx Endpoint */
+    Endpoint_SelectEndpoint(CDC_TX_EPADDR);
+
+    /* Bank still in use by the host, come back next loop instead of spinning */
+    if(!Endpoint_IsINReady()) return 0;
 
-            // Send an empty packet to prevent host buffering
+    uint8_t pending = rb_length_TX(&_usb_send_buffer);
+
+    if(pending == 0){
+        if(_usb_zlp_pending){
+            // Terminate the previous full packet so the host stops buffering
             Endpoint_ClearIN();
+            _usb_zlp_pending = false;
+        }
+        return 0;
+    }
+
+    uint8_t to_send = (pending < CDC_TXRX_EPSIZE) ? pending : CDC_TXRX_EPSIZE;
+    uint8_t written = 0;
+
+    // At most two contiguous runs: up to the end of the array, then from its start
+    while(written < to_send){
+        char*   p_region;
+        uint8_t run = rb_read_peek_contiguous_TX(&_usb_send_buffer, written, &p_region);
+        if(run > to_send - written) run = to_send - written;
+
+        for(uint8_t i = 0; i < run; i++){
+            Endpoint_Write_8(p_region[i]);
         }
+        written += run;
     }
+    rb_read_consume_TX(&_usb_send_buffer, written);
+
+    Endpoint_ClearIN();
+
+    // A short packet ends the transfer on its own, a full one needs a ZLP unless more data follows
+    _usb_zlp_pending = (written == CDC_TXRX_EPSIZE);
+
+    return written;
 }
 
 /**
@@ -331,7 +454,7 @@ void usb_write_next_byte()
  */
 void usb_send_byte(uint8_t byte)
 {
-	rb_push_back_C(&_usb_send_buffer,byte);
+	usb_send_data(&byte, sizeof(byte));
 }
 
 /**
@@ -339,19 +462,55 @@ void usb_send_byte(uint8_t byte)
  * @param p_data [void*] pointer to the data-object to be sent
  * @param data_len [uint8_t] size of data-object to be sent
  */
-void usb_send_data(void* p_data, uint8_t data_len)
+bool usb_send_data(void* p_data, uint8_t data_len)
 {
 	char* data = p_data;
-    for(uint8_t i=0;i<data_len;i++){
-		rb_push_back_C(&_usb_send_buffer,data[i]);
-	}
+
+    // Apply the full policy before copying anything
+    bool    complete   = true;
+    uint8_t free_count = rb_free_TX(&_usb_send_buffer);
+    if(data_len > free_count){
+        switch(_usb_send_policy){
+            case USB_FULL_OVERWRITE:    // make room by dropping the oldest queued bytes
+                rb_read_consume_TX(&_usb_send_buffer, data_len - free_count);
+                _usb_send_stats.dropped_bytes += data_len - free_count;
+                break;
+            case USB_FULL_REJECT:       // send what fits, drop the rest
+                _usb_send_stats.dropped_bytes += data_len - free_count;
+                data_len = free_count;
+                complete = false;
+                break;
+            case USB_FULL_REJECT_FRAME: // all or nothing
+            default:
+                _usb_send_stats.dropped_bytes += data_len;
+                _usb_send_stats.dropped_frames++;
+                return false;
+        }
+    }
+
+    uint8_t copied = 0;
+    while(copied < data_len){
+        char*   p_region;
+        uint8_t run = rb_write_reserve_TX(&_usb_send_buffer, copied, &p_region);
+        if(run > data_len - copied) run = data_len - copied;
+
+        memcpy(p_region, data + copied, run);
+        copied += run;
+    }
+    rb_write_commit_TX(&_usb_send_buffer, copied);
+
+    if(rb_length_TX(&_usb_send_buffer) > _usb_send_stats.high_water){
+        _usb_send_stats.high_water = rb_length_TX(&_usb_send_buffer);
+    }
+
+    return complete;
 }
 
 /**
  * (non-blocking) Function usb_send_str adds a c-style (null terminated) string to the output buffer
  * @param p_str [char*] Pointer to a c-string (null terminated) to send
  */
-void usb_send_str(char* p_str)
+bool usb_send_str(char* p_str)
 {
     // Remember c-srtings are null terminated.
 	// uint8_t i = 0;
@@ -359,11 +518,8 @@ void usb_send_str(char* p_str)
 	// 	rb_push_back_C(&_usb_send_buffer,p_str[i]);
 	// 	i++;
 	// }
-    for(uint8_t i = 0; p_str[i] != 0; i++) {
-        rb_push_back_C(&_usb_send_buffer, p_str[i]);
-    }
-    // Need to add 0 to the end to keep the Null character
-    rb_push_back_C(&_usb_send_buffer,0);
+    // Need to add 1 to the length to keep the Null character
+    return usb_send_data(p_str, strlen(p_str) + 1);
 }
 
 /**
@@ -384,29 +540,339 @@ void usb_send_str(char* p_str)
  * @param p_data [void*] pointer to the data-object to send.
  * @param data_len [uint8_t] size of the data-object to send. Remember sizeof() can help you with this!
  */
-void usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len )
+bool usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len )
 {
     // Remember c-strings are null terminated. Use the above functions to help!
 
-    // FUNCTION BEGIN
-    //  Calculate the length of the format string taking into account the null-termination (+1 for null termination)
-    //  Calculate the total message length:  1 + format_length + data_len
-    //  Send data:
-    //      usb_send_byte <-- length
-    //      usb_send_str  <-- format
-    //      usb_send_byte <-- cmd
-    //      usb_send_data <-- p_data
-    // FUNCTION END
-
-    // Calculate the length of the format string
+    // The frame builder reserves [length][format][cmd][data] up front, so the message is either queued
+    // whole or not at all.
+    USB_Frame_t frame;
+
+    if(!usb_frame_begin(&frame, format, cmd, data_len)) return false;
+
+    usb_frame_write(&frame, p_data, data_len);
+    return usb_frame_commit(&frame);
+}
+
+static bool _usb_frame_reserve(USB_Frame_t* p_frame, uint16_t total_len);
+
+/**
+ * Function _usb_frame_put copies bytes into the uncommitted region of the send buffer behind the frame's cursor.
+ */
+static void _usb_frame_put(USB_Frame_t* p_frame, const void* p_src, uint8_t len)
+{
+    const char* src = p_src;
+
+    while(len){
+        char*   p_region;
+        uint8_t run = rb_write_reserve_TX(&_usb_send_buffer, p_frame->written, &p_region);
+        if(run > len) run = len;
+
+        memcpy(p_region, src, run);
+        p_frame->written += run;
+        src += run;
+        len -= run;
+    }
+}
+
+/**
+ * (non-blocking) Function usb_frame_begin reserves room for a whole MEGN540 message (msg_len + 1 bytes) in the
+ * send buffer and writes its header ([MSG Length][Format C-Str][CMD Char]). Nothing is visible to the USB
+ * transmitter until usb_frame_commit is called.
+ * @param p_frame [USB_Frame_t*] frame object to fill in
+ * @param format [c-str pointer] Pointer to interpertation string, as for usb_send_msg
+ * @param cmd [char] Command this message is in response to.
+ * @param data_len [uint8_t] number of DATA bytes the caller will write with usb_frame_write
+ * @return [bool] True if the frame was reserved, False if the send buffer has no room (the frame is counted
+ *          as dropped unless the buffer policy is USB_FULL_OVERWRITE, which makes room instead).
+ */
+bool usb_frame_begin(USB_Frame_t* p_frame, char* format, char cmd, uint8_t data_len)
+{
+    // Calculate the length of the format string taking into account the null-termination (+1 for null termination)
     uint8_t fmt_len = strlen(format) + 1;
-    // Calculate the total message length
-    uint8_t msg_len = 1 + fmt_len + data_len;
+    // Calculate the total message length:  1 + format_length + data_len
+    uint16_t total_len = 2 + fmt_len + data_len; // length byte + cmd + format + data
+    uint8_t  msg_len   = total_len - 1;
+
+    if(!_usb_frame_reserve(p_frame, total_len)) return false;
+
+    _usb_frame_put(p_frame, &msg_len, sizeof(msg_len));
+    _usb_frame_put(p_frame, format, fmt_len);
+    _usb_frame_put(p_frame, &cmd, sizeof(cmd));
+
+    return true;
+}
+
+/**
+ * Function _usb_frame_reserve makes room for total_len bytes in the send buffer according to the send policy.
+ * @return [bool] True if the frame may be written
+ */
+static bool _usb_frame_reserve(USB_Frame_t* p_frame, uint16_t total_len)
+{
+    p_frame->reserved = total_len;
+    p_frame->written  = 0;
+    p_frame->valid    = false;
+
+    // A frame longer than the length byte can describe can never be sent
+    if(total_len >= USB_SEND_BUFFER_LENGTH){
+        _usb_send_stats.dropped_frames++;
+        return false;
+    }
+
+    uint8_t free_count = rb_free_TX(&_usb_send_buffer);
+    if(p_frame->reserved > free_count){
+        if(_usb_send_policy == USB_FULL_OVERWRITE){
+            rb_read_consume_TX(&_usb_send_buffer, p_frame->reserved - free_count);
+            _usb_send_stats.dropped_bytes += p_frame->reserved - free_count;
+        }else{
+            _usb_send_stats.dropped_bytes += p_frame->reserved;
+            _usb_send_stats.dropped_frames++;
+            return false;
+        }
+    }
+
+    p_frame->valid = true;
+    return true;
+}
+
+/**
+ * Function _usb_format_announce queues the [MSG Length][0x02][ID][Format C-Str] frame telling the host what
+ * format an ID stands for.
+ * @return [bool] True if the announcement was queued
+ */
+static bool _usb_format_announce(uint8_t id)
+{
+    USB_Frame_t frame;
+    uint8_t  fmt_len   = strlen(_usb_formats[id]) + 1;
+    uint16_t total_len = 3 + fmt_len; // length byte + marker + id + format
+    uint8_t  msg_len   = total_len - 1;
+    uint8_t  marker    = USB_FRAME_FORMAT_ANNOUNCE;
+
+    if(!_usb_frame_reserve(&frame, total_len)) return false;
+
+    _usb_frame_put(&frame, &msg_len, sizeof(msg_len));
+    _usb_frame_put(&frame, &marker, sizeof(marker));
+    _usb_frame_put(&frame, &id, sizeof(id));
+    _usb_frame_put(&frame, _usb_formats[id], fmt_len);
+
+    return usb_frame_commit(&frame);
+}
+
+/**
+ * Function _usb_format_ready announces a registered format to the host if that has not been done yet. The host
+ * cannot decode a tagged frame before it has seen the announcement.
+ * @return [bool] True if frames using the format may be sent
+ */
+static bool _usb_format_ready(uint8_t id)
+{
+    if(id >= _usb_format_count) return false;
 
-    usb_send_byte(msg_len);
-    usb_send_str(format);
-    usb_send_byte(cmd);
-    usb_send_data(p_data,data_len);
+    if(!(_usb_format_announced & (1ul << id))){
+        if(!_usb_format_announce(id)) return false;
+        _usb_format_announced |= 1ul << id;
+    }
+
+    return true;
+}
+
+/**
+ * (non-blocking) Function usb_register_format adds a format string to the device's format table so messages
+ * can be sent tagged with a one byte ID instead of the whole string (see usb_send_msg_id). Registering the same
+ * string twice returns the same ID.
+ * @param format [c-str pointer] interpertation string, as for usb_send_msg. Must stay valid (e.g. a literal).
+ * @return [uint8_t] the format's ID, or USB_FORMAT_INVALID if the table is full
+ */
+uint8_t usb_register_format(char* format)
+{
+    for(uint8_t id = 0; id < _usb_format_count; id++){
+        if(strcmp(_usb_formats[id], format) == 0) return id;
+    }
+
+    if(_usb_format_count >= USB_FORMAT_MAX) return USB_FORMAT_INVALID;
+
+    _usb_formats[_usb_format_count] = format;
+    _usb_format_announced &= ~(1ul << _usb_format_count);
+    return _usb_format_count++;
+}
+
+/**
+ * (non-blocking) Function usb_announce_formats marks every registered format as unannounced, so each is sent to
+ * the host again the next time its ID is used. Call this when the host (re)connects.
+ */
+void usb_announce_formats()
+{
+    _usb_format_announced = 0;
+}
+
+/**
+ * (non-blocking) Function usb_frame_begin_id is usb_frame_begin for a registered format. The frame is
+ *      [MSG Length] [0x01] [Format ID] [Host Initiating CMD Char] [DATA]
+ * The format is announced to the host first if it has not been yet.
+ * @param p_frame [USB_Frame_t*] frame object to fill in
+ * @param format_id [uint8_t] ID returned by usb_register_format
+ * @param cmd [char] Command this message is in response to.
+ * @param data_len [uint8_t] number of DATA bytes the caller will write with usb_frame_write
+ * @return [bool] True if the frame was reserved
+ */
+bool usb_frame_begin_id(USB_Frame_t* p_frame, uint8_t format_id, char cmd, uint8_t data_len)
+{
+    p_frame->valid = false;
+    if(!_usb_format_ready(format_id)) return false;
+
+    uint16_t total_len = 4 + data_len; // length byte + marker + id + cmd + data
+    uint8_t  msg_len   = total_len - 1;
+    uint8_t  marker    = USB_FRAME_FORMAT_ID;
+
+    if(!_usb_frame_reserve(p_frame, total_len)) return false;
+
+    _usb_frame_put(p_frame, &msg_len, sizeof(msg_len));
+    _usb_frame_put(p_frame, &marker, sizeof(marker));
+    _usb_frame_put(p_frame, &format_id, sizeof(format_id));
+    _usb_frame_put(p_frame, &cmd, sizeof(cmd));
+
+    return true;
+}
+
+/**
+ * (non-blocking) Function usb_send_msg_id is usb_send_msg for a registered format. It sends the one byte format
+ * ID in place of the format string.
+ * @param format_id [uint8_t] ID returned by usb_register_format
+ * @param cmd [char] Command this message is in respose to.
+ * @param p_data [void*] pointer to the data-object to send.
+ * @param data_len [uint8_t] size of the data-object to send.
+ * @return [bool] True if the whole message was queued
+ */
+bool usb_send_msg_id(uint8_t format_id, char cmd, void* p_data, uint8_t data_len)
+{
+    USB_Frame_t frame;
+
+    if(!usb_frame_begin_id(&frame, format_id, cmd, data_len)) return false;
+
+    usb_frame_write(&frame, p_data, data_len);
+    return usb_frame_commit(&frame);
+}
+
+/**
+ * (non-blocking) Function usb_batch_init sets up a staging buffer that packs several samples of a registered
+ * format into one frame.
+ * @param p_batch [USB_Batch_t*] batch object to initialize
+ * @param format_id [uint8_t] ID returned by usb_register_format. The format describes one row: the CMD char
+ *          followed by one sample.
+ * @param cmd [char] Command the samples are in response to.
+ * @param sample_len [uint8_t] size of one sample (not counting the CMD char)
+ * @param samples_per_frame [uint8_t] number of samples to collect before a frame is sent. Limited to what fits
+ *          in USB_BATCH_MAX_BYTES.
+ * @return [bool] True if at least one sample fits in the staging buffer
+ */
+bool usb_batch_init(USB_Batch_t* p_batch, uint8_t format_id, char cmd, uint8_t sample_len, uint8_t samples_per_frame)
+{
+    p_batch->format_id  = format_id;
+    p_batch->cmd        = cmd;
+    p_batch->sample_len = sample_len;
+    p_batch->count      = 0;
+
+    uint8_t capacity = (sample_len > 0) ? USB_BATCH_MAX_BYTES / sample_len : 0;
+    if(samples_per_frame == 0) samples_per_frame = 1;
+    p_batch->samples_per_frame = (samples_per_frame < capacity) ? samples_per_frame : capacity;
+
+    return p_batch->samples_per_frame > 0;
+}
+
+/**
+ * (non-blocking) Function usb_batch_add copies a sample into the staging buffer and sends the frame once
+ * samples_per_frame samples have been collected.
+ * @param p_batch [USB_Batch_t*] batch set up with usb_batch_init
+ * @param p_sample [void*] pointer to sample_len bytes
+ * @return [bool] False if a full batch could not be queued (those samples are lost)
+ */
+bool usb_batch_add(USB_Batch_t* p_batch, const void* p_sample)
+{
+    if(p_batch->samples_per_frame == 0) return false;
+
+    memcpy(&p_batch->data[p_batch->count * p_batch->sample_len], p_sample, p_batch->sample_len);
+    p_batch->count++;
+
+    if(p_batch->count >= p_batch->samples_per_frame){
+        return usb_batch_flush(p_batch);
+    }
+
+    return true;
+}
+
+/**
+ * (non-blocking) Function usb_batch_flush sends the samples collected so far as one frame:
+ *      [MSG Length] [0x03] [Format ID] [Sample Count] [CMD Char] [Sample 0] ... [Sample Count-1]
+ * The staging buffer is emptied whether or not the frame fit in the send buffer.
+ * @param p_batch [USB_Batch_t*] batch set up with usb_batch_init
+ * @return [bool] True if the frame was queued (or there was nothing to send)
+ */
+bool usb_batch_flush(USB_Batch_t* p_batch)
+{
+    if(p_batch->count == 0) return true;
+
+    uint8_t  count     = p_batch->count;
+    uint8_t  data_len  = count * p_batch->sample_len;
+    p_batch->count     = 0;
+
+    if(!_usb_format_ready(p_batch->format_id)) return false;
+
+    USB_Frame_t frame;
+    uint16_t total_len = 5 + data_len; // length byte + marker + id + count + cmd + samples
+    uint8_t  msg_len   = total_len - 1;
+    uint8_t  marker    = USB_FRAME_FORMAT_BATCH;
+
+    if(!_usb_frame_reserve(&frame, total_len)) return false;
+
+    _usb_frame_put(&frame, &msg_len, sizeof(msg_len));
+    _usb_frame_put(&frame, &marker, sizeof(marker));
+    _usb_frame_put(&frame, &p_batch->format_id, sizeof(p_batch->format_id));
+    _usb_frame_put(&frame, &count, sizeof(count));
+    _usb_frame_put(&frame, &p_batch->cmd, sizeof(p_batch->cmd));
+    _usb_frame_put(&frame, p_batch->data, data_len);
+
+    return usb_frame_commit(&frame);
+}
+
+/**
+ * (non-blocking) Function usb_frame_write copies a field straight into the frame's reserved region of the send
+ * buffer. Writes past the reserved length are refused.
+ * @param p_frame [USB_Frame_t*] frame started with usb_frame_begin
+ * @param p_src [void*] pointer to the field to add
+ * @param len [uint8_t] size of the field
+ * @return [bool] True if the field was written
+ */
+bool usb_frame_write(USB_Frame_t* p_frame, const void* p_src, uint8_t len)
+{
+    if(!p_frame->valid || len > p_frame->reserved - p_frame->written) return false;
+
+    _usb_frame_put(p_frame, p_src, len);
+    return true;
+}
+
+/**
+ * (non-blocking) Function usb_frame_commit publishes a completely written frame to the USB transmitter with a
+ * single index update. An incompletely written frame is discarded instead.
+ * @param p_frame [USB_Frame_t*] frame started with usb_frame_begin
+ * @return [bool] True if the frame was queued for sending
+ */
+bool usb_frame_commit(USB_Frame_t* p_frame)
+{
+    if(!p_frame->valid) return false;
+    p_frame->valid = false;
+
+    if(p_frame->written != p_frame->reserved){
+        _usb_send_stats.dropped_bytes += p_frame->reserved;
+        _usb_send_stats.dropped_frames++;
+        return false;
+    }
+
+    rb_write_commit_TX(&_usb_send_buffer, p_frame->written);
+
+    if(rb_length_TX(&_usb_send_buffer) > _usb_send_stats.high_water){
+        _usb_send_stats.high_water = rb_length_TX(&_usb_send_buffer);
+    }
+
+    return true;
 }
 
 /*
@@ -460,10 +926,18 @@ bool usb_msg_read_into(void* p_obj, uint8_t data_len)
     // If not enough bytes available
     if(usb_msg_length() < data_len) return false;
     
-    char* msg = p_obj;
-    for(uint8_t i=0;i<data_len;i++){
-        msg[i] = rb_pop_front_C(&_usb_receive_buffer);
+    // Copy out in (at most two) contiguous blocks, then release them all at once
+    char*   msg = p_obj;
+    uint8_t copied = 0;
+    while(copied < data_len){
+        char*   p_region;
+        uint8_t run = rb_read_peek_contiguous_C(&_usb_receive_buffer, copied, &p_region);
+        if(run > data_len - copied) run = data_len - copied;
+
+        memcpy(msg + copied, p_region, run);
+        copied += run;
     }
+    rb_read_consume_C(&_usb_receive_buffer, data_len);
     // If success
     return true;
 }
@@ -475,4 +949,39 @@ bool usb_msg_read_into(void* p_obj, uint8_t data_len)
 void usb_flush_input_buffer()
 {
     rb_initialize_C(&_usb_receive_buffer);
+}
+
+/**
+ * Function usb_set_full_policy chooses what the send or receive buffer does when more data arrives than it
+ * has room for.
+ * @param send_buffer [bool] true to configure the send buffer, false for the receive buffer
+ * @param policy [USB_Full_Policy_t] the new policy
+ */
+void usb_set_full_policy(bool send_buffer, USB_Full_Policy_t policy)
+{
+    if(send_buffer){
+        _usb_send_policy = policy;
+    }else{
+        _usb_receive_policy = policy;
+    }
+}
+
+/**
+ * Function usb_get_buffer_stats copies out the drop counters and high-water marks of both buffers.
+ * @param p_send [USB_Buffer_Stats_t*] filled with the send buffer statistics
+ * @param p_receive [USB_Buffer_Stats_t*] filled with the receive buffer statistics
+ */
+void usb_get_buffer_stats(USB_Buffer_Stats_t* p_send, USB_Buffer_Stats_t* p_receive)
+{
+    *p_send    = _usb_send_stats;
+    *p_receive = _usb_receive_stats;
+}
+
+/**
+ * Function usb_reset_buffer_stats zeros the drop counters and high-water marks of both buffers.
+ */
+void usb_reset_buffer_stats()
+{
+    memset(&_usb_send_stats, 0, sizeof(_usb_send_stats));
+    memset(&_usb_receive_stats, 0, sizeof(_usb_receive_stats));
 }
\ No newline at end of file
@@ -70,6 +70,54 @@
 #include "Timing.h"
 #include "MEGN540_MessageHandeling.h"
 
+/**
+ * USB_Full_Policy_t selects what a USB buffer does when data arrives that does not fit.
+ *   USB_FULL_OVERWRITE:    the oldest queued bytes are dropped to make room (original ring buffer behavior)
+ *   USB_FULL_REJECT:       as many bytes as fit are kept, the rest are dropped. On the receive side the
+ *                          bytes are simply left in the USB endpoint, which makes the host wait.
+ *   USB_FULL_REJECT_FRAME: each usb_send_* call is queued or dropped as a unit. Treated as USB_FULL_REJECT
+ *                          for receiving.
+ * Messages built with usb_send_msg or the usb_frame_* functions are always queued or dropped whole (unless the
+ * policy is USB_FULL_OVERWRITE), so the host never sees a torn frame.
+ */
+typedef enum { USB_FULL_OVERWRITE, USB_FULL_REJECT, USB_FULL_REJECT_FRAME } USB_Full_Policy_t;
+
+/**
+ * USB_Buffer_Stats_t counts what a USB buffer had to drop and the most bytes it has held at once.
+ */
+typedef struct { uint16_t dropped_bytes; uint16_t dropped_frames; uint8_t high_water; } USB_Buffer_Stats_t;
+
+/**
+ * USB_Frame_t tracks a message being built in place in the send buffer (see usb_frame_begin).
+ */
+typedef struct { uint8_t reserved; uint8_t written; bool valid; } USB_Frame_t;
+
+/**
+ * Format registry. A frame whose first byte after [MSG Length] is one of these markers (format strings are
+ * printable, so they never start with one) is:
+ *   USB_FRAME_FORMAT_ID:       [MSG Length] [0x01] [Format ID] [CMD Char] [DATA]
+ *   USB_FRAME_FORMAT_ANNOUNCE: [MSG Length] [0x02] [Format ID] [Format C-Str]
+ *   USB_FRAME_FORMAT_BATCH:    [MSG Length] [0x03] [Format ID] [Sample Count] [CMD Char] [Samples...]
+ */
+#define USB_FRAME_FORMAT_ID       0x01
+#define USB_FRAME_FORMAT_ANNOUNCE 0x02
+#define USB_FRAME_FORMAT_BATCH    0x03
+#define USB_FORMAT_MAX            32   // at most 32, the announced flags are a uint32_t bitmask
+#define USB_FORMAT_INVALID        0xFF
+
+/**
+ * USB_Batch_t stages samples of one registered format so they can be sent several to a frame (see usb_batch_init).
+ */
+#define USB_BATCH_MAX_BYTES 120
+typedef struct {
+    uint8_t format_id;
+    char    cmd;
+    uint8_t sample_len;
+    uint8_t samples_per_frame;
+    uint8_t count;
+    uint8_t data[USB_BATCH_MAX_BYTES];
+} USB_Batch_t;
+
 
 /* LUFA Specific Function Prototypes: */
 void USB_SetupHardware(void);  // You'll need to add in any initialization items to this function for your ring buffers
@@ -94,12 +142,26 @@ void EVENT_USB_Device_ControlRequest(void);
  */
 void usb_read_next_byte();
 
+/**
+ * (non-blocking) Function usb_read_bulk moves every byte waiting in the USB endpoint (up to the free space
+ * in the receive ring buffer) into the ring buffer in a single call.
+ * @return [uint8_t] Number of bytes moved into the receive buffer.
+ */
+uint8_t usb_read_bulk();
+
 /**
  * (non-blocking) Function usb_write_next_byte takes the next byte from the output
  * ringbuffer and writes it to the USB port (if free).
  */
 void usb_write_next_byte();
 
+/**
+ * (non-blocking) Function usb_write_bulk writes up to one full packet from the output ringbuffer to the USB
+ * port (if free) and handles zero length packet termination without waiting on the endpoint.
+ * @return [uint8_t] Number of bytes written to the endpoint.
+ */
+uint8_t usb_write_bulk();
+
 /**
  * (non-blocking) Function usb_send_byte Adds a character to the output buffer
  * @param byte [uint8_t] Data to send
@@ -110,14 +172,16 @@ void usb_send_byte(uint8_t byte);
  * (non-blocking) Function usb_send_data adds the data buffer to the output ring buffer.
  * @param p_data [void*] pointer to the data-object to be sent
  * @param data_len [uint8_t] size of data-object to be sent
+ * @return [bool] True if all bytes were queued, False if some or all were dropped by the full policy
  */
-void usb_send_data(void* p_data, uint8_t data_len);
+bool usb_send_data(void* p_data, uint8_t data_len);
 
 /**
  * (non-blocking) Function usb_send_str adds a c-style (null terminated) string to the output buffer
  * @param p_str [char*] Pointer to a c-string (null terminated) to send
+ * @return [bool] True if the whole string was queued
  */
-void usb_send_str(char* p_str);
+bool usb_send_str(char* p_str);
 
 /**
  * (non-blocking) Function usb_send_msg sends a message according to the MEGN540 USB message format.
@@ -136,8 +200,81 @@ void usb_send_str(char* p_str);
  * @param cmd [char] Command this message is in respose to.
  * @param p_data [void*] pointer to the data-object to send.
  * @param data_len [uint8_t] size of the data-object to send. Remember sizeof() can help you with this!
+ * @return [bool] True if the whole message was queued, False if the send buffer's full policy dropped it
+ */
+bool usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len );
+
+/**
+ * (non-blocking) Functions usb_frame_begin, usb_frame_write, and usb_frame_commit build a message in the MEGN540
+ * USB message format directly in the send buffer, without first assembling the DATA in a struct:
+ *
+ *      USB_Frame_t frame;
+ *      if( usb_frame_begin(&frame, "cfh", 'x', sizeof(float) + sizeof(int16_t)) ){
+ *          usb_frame_write(&frame, &my_float, sizeof(my_float));
+ *          usb_frame_write(&frame, &my_int,   sizeof(my_int));
+ *          usb_frame_commit(&frame);
+ *      }
+ *
+ * usb_frame_begin reserves the whole message (msg_len + 1 bytes) and fails cleanly if it does not fit.
+ * usb_frame_write copies each field straight into the reserved region.
+ * usb_frame_commit makes the message visible to the transmitter in one step (only if every reserved byte was
+ * written).
+ */
+bool usb_frame_begin(USB_Frame_t* p_frame, char* format, char cmd, uint8_t data_len);
+bool usb_frame_write(USB_Frame_t* p_frame, const void* p_src, uint8_t len);
+bool usb_frame_commit(USB_Frame_t* p_frame);
+
+/**
+ * (non-blocking) Function usb_register_format adds a format string to the device's format table and returns its
+ * one byte ID (USB_FORMAT_INVALID if the table is full). Messages sent with usb_send_msg_id or
+ * usb_frame_begin_id carry the ID instead of the format string. The first time an ID is used the device sends an
+ * announcement frame so the host can learn the ID -> format mapping.
+ * @param format [c-str pointer] interpertation string, as for usb_send_msg. Must stay valid (e.g. a literal).
+ * @return [uint8_t] the format's ID
+ */
+uint8_t usb_register_format(char* format);
+
+/**
+ * (non-blocking) Function usb_announce_formats makes the device re-announce every registered format the next time
+ * it is used. Call this when the host (re)connects; the '#' command does.
+ */
+void usb_announce_formats();
+
+/**
+ * (non-blocking) Function usb_send_msg_id is usb_send_msg for a format registered with usb_register_format.
+ * @param format_id [uint8_t] ID returned by usb_register_format
+ * @param cmd [char] Command this message is in respose to.
+ * @param p_data [void*] pointer to the data-object to send.
+ * @param data_len [uint8_t] size of the data-object to send.
+ * @return [bool] True if the whole message was queued
  */
-void usb_send_msg(char* format, char cmd, void* p_data, uint8_t data_len );
+bool usb_send_msg_id(uint8_t format_id, char cmd, void* p_data, uint8_t data_len);
+
+/**
+ * (non-blocking) Function usb_frame_begin_id is usb_frame_begin for a format registered with usb_register_format.
+ * @param p_frame [USB_Frame_t*] frame object to fill in
+ * @param format_id [uint8_t] ID returned by usb_register_format
+ * @param cmd [char] Command this message is in response to.
+ * @param data_len [uint8_t] number of DATA bytes the caller will write with usb_frame_write
+ * @return [bool] True if the frame was reserved
+ */
+bool usb_frame_begin_id(USB_Frame_t* p_frame, uint8_t format_id, char cmd, uint8_t data_len);
+
+/**
+ * (non-blocking) Functions usb_batch_init, usb_batch_add, and usb_batch_flush pack several samples of a
+ * registered format into one frame, so high rate streams pay the frame header once per batch:
+ *
+ *      usb_batch_init(&batch, usb_register_format("cf4h"), 'R', sizeof(sample), 10);
+ *      ...
+ *      usb_batch_add(&batch, &sample);   // sends a frame every 10th sample
+ *      ...
+ *      usb_batch_flush(&batch);          // sends whatever is left when the stream stops
+ *
+ * The format describes one row (CMD char + one sample); the host expands a batch frame back into rows.
+ */
+bool usb_batch_init(USB_Batch_t* p_batch, uint8_t format_id, char cmd, uint8_t sample_len, uint8_t samples_per_frame);
+bool usb_batch_add(USB_Batch_t* p_batch, const void* p_sample);
+bool usb_batch_flush(USB_Batch_t* p_batch);
 
 /**
  * (non-blocking) Funtion usb_msg_length returns the number of bytes in the receive buffer awaiting processing.
@@ -181,6 +318,24 @@ bool usb_msg_read_into(void* p_obj, uint8_t data_len);
  */
 void usb_flush_input_buffer();
 
+/**
+ * Function usb_set_full_policy chooses what the send (default USB_FULL_REJECT_FRAME) or receive (default
+ * USB_FULL_REJECT) buffer does when it is full.
+ * @param send_buffer [bool] true to configure the send buffer, false for the receive buffer
+ * @param policy [USB_Full_Policy_t] the new policy
+ */
+void usb_set_full_policy(bool send_buffer, USB_Full_Policy_t policy);
+
+/**
+ * Function usb_get_buffer_stats copies out the drop counters and high-water marks of both buffers.
+ */
+void usb_get_buffer_stats(USB_Buffer_Stats_t* p_send, USB_Buffer_Stats_t* p_receive);
+
+/**
+ * Function usb_reset_buffer_stats zeros the drop counters and high-water marks of both buffers.
+ */
+void usb_reset_buffer_stats();
+
 /**
  * Function DebugPrint sends a message according to the MEGN540 USB message format to help with debugging.
  */
@@ -0,0 +1,208 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+#include "Timer_Wheel.h"
+
+#include <stddef.h>
+#include <util/atomic.h> // timers are shared with the Timer0 ISR
+
+_Static_assert(TIMER_WHEEL_COUNT <= 32, "Timer_Wheel: pending flags hold at most 32 timers");
+_Static_assert((TIMER_WHEEL_SLOTS & (TIMER_WHEEL_SLOTS - 1)) == 0, "Timer_Wheel: TIMER_WHEEL_SLOTS must be a power of two");
+
+#define TIMER_WHEEL_NONE 0xFF   // end of a slot list
+
+/** Timer state. expiry is in wheel ticks; next links the timers of one slot. */
+typedef struct {
+    uint32_t expiry;
+    uint32_t period;
+    Timer_Wheel_Callback_t callback;
+    uint8_t  next;
+    bool     armed;
+} Timer_Wheel_Timer_t;
+
+static Timer_Wheel_Timer_t _timers[TIMER_WHEEL_COUNT];
+static uint8_t             _slots[TIMER_WHEEL_SLOTS];
+static uint32_t            _now;
+
+// Set by the ISR on expiry, cleared by Timer_Wheel_Pending/Timer_Wheel_Run
+static volatile uint32_t   _pending;
+
+/**
+ * Function _timer_wheel_insert links a timer into the slot of its expiry time. Interrupts must be off (or called
+ * from the ISR).
+ */
+static void _timer_wheel_insert(uint8_t id)
+{
+    uint8_t slot = _timers[id].expiry & (TIMER_WHEEL_SLOTS - 1);
+    _timers[id].next = _slots[slot];
+    _slots[slot] = id;
+}
+
+/**
+ * Function _timer_wheel_remove unlinks a timer from its slot. Interrupts must be off.
+ */
+static void _timer_wheel_remove(uint8_t id)
+{
+    uint8_t* p_link = &_slots[_timers[id].expiry & (TIMER_WHEEL_SLOTS - 1)];
+
+    while(*p_link != TIMER_WHEEL_NONE){
+        if(*p_link == id){
+            *p_link = _timers[id].next;
+            return;
+        }
+        p_link = &_timers[*p_link].next;
+    }
+}
+
+/**
+ * Function Timer_Wheel_Init stops every timer and clears the pending flags. SetupTimer0 calls this.
+ */
+void Timer_Wheel_Init()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        for(uint8_t i = 0; i < TIMER_WHEEL_SLOTS; i++){
+            _slots[i] = TIMER_WHEEL_NONE;
+        }
+        for(uint8_t i = 0; i < TIMER_WHEEL_COUNT; i++){
+            _timers[i].armed = false;
+        }
+        _pending = 0;
+    }
+}
+
+/**
+ * Function Timer_Wheel_Start (re)starts a timer.
+ * @param timer_id [uint8_t] timer to start, 0 to TIMER_WHEEL_COUNT-1
+ * @param delay_ms [uint32_t] time until the first expiry (at least 1 ms)
+ * @param period_ms [uint32_t] repeat period after the first expiry, 0 for a one-shot timer
+ * @param callback [Timer_Wheel_Callback_t] function Timer_Wheel_Run calls on expiry, NULL to use the pending flag
+ */
+void Timer_Wheel_Start(uint8_t timer_id, uint32_t delay_ms, uint32_t period_ms, Timer_Wheel_Callback_t callback)
+{
+    if(timer_id >= TIMER_WHEEL_COUNT) return;
+    if(delay_ms == 0) delay_ms = 1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        if(_timers[timer_id].armed) _timer_wheel_remove(timer_id);
+
+        _timers[timer_id].expiry   = _now + delay_ms;
+        _timers[timer_id].period   = period_ms;
+        _timers[timer_id].callback = callback;
+        _timers[timer_id].armed    = true;
+        _timer_wheel_insert(timer_id);
+
+        _pending &= ~(1ul << timer_id);
+    }
+}
+
+/**
+ * Function Timer_Wheel_Stop stops a timer and clears its pending flag.
+ * @param timer_id [uint8_t] timer to stop
+ */
+void Timer_Wheel_Stop(uint8_t timer_id)
+{
+    if(timer_id >= TIMER_WHEEL_COUNT) return;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        if(_timers[timer_id].armed) _timer_wheel_remove(timer_id);
+        _timers[timer_id].armed = false;
+        _pending &= ~(1ul << timer_id);
+    }
+}
+
+/**
+ * Function Timer_Wheel_Pending indicates if a timer expired since the last call, and clears the flag.
+ * @param timer_id [uint8_t] timer to check
+ * @return [bool] True if the timer has expired
+ */
+bool Timer_Wheel_Pending(uint8_t timer_id)
+{
+    if(timer_id >= TIMER_WHEEL_COUNT) return false;
+
+    bool pending;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        pending = (_pending & (1ul << timer_id)) != 0;
+        _pending &= ~(1ul << timer_id);
+    }
+    return pending;
+}
+
+/**
+ * Function Timer_Wheel_Run calls the callbacks of all expired timers started with a callback. Call it from the
+ * main loop.
+ */
+void Timer_Wheel_Run()
+{
+    if(_pending == 0) return; // a single byte-wise read is fine here, it is re-read atomically below
+
+    for(uint8_t id = 0; id < TIMER_WHEEL_COUNT; id++){
+        Timer_Wheel_Callback_t callback = NULL;
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            if((_pending & (1ul << id)) && _timers[id].callback != NULL){
+                _pending &= ~(1ul << id);
+                callback = _timers[id].callback;
+            }
+        }
+
+        // Run outside the atomic block so the callback can take its time (and restart timers)
+        if(callback != NULL) callback(id);
+    }
+}
+
+/**
+ * Function Timer_Wheel_Tick advances the wheel by one millisecond. It is called from the Timer0 compare ISR.
+ */
+void Timer_Wheel_Tick()
+{
+    _now++;
+
+    uint8_t* p_link = &_slots[_now & (TIMER_WHEEL_SLOTS - 1)];
+    while(*p_link != TIMER_WHEEL_NONE){
+        uint8_t id = *p_link;
+        Timer_Wheel_Timer_t* p_timer = &_timers[id];
+
+        // Timers hashed here that expire on a later lap of the wheel stay put
+        if(p_timer->expiry != _now){
+            p_link = &p_timer->next;
+            continue;
+        }
+
+        *p_link = p_timer->next; // unlink, p_link now refers to the following timer
+        _pending |= 1ul << id;
+
+        if(p_timer->period > 0){
+            p_timer->expiry += p_timer->period; // from the expiry, not from now, so it does not drift
+            _timer_wheel_insert(id);            // if it lands back in this slot the walk skips it (later lap)
+        }else{
+            p_timer->armed = false;
+        }
+    }
+}
@@ -0,0 +1,100 @@
+/*
+         MEGN540 Mechatronics Lab
+    Copyright (C) Andrew Petruska, 2021.
+       apetruska [at] mines [dot] edu
+          www.mechanical.mines.edu
+*/
+
+/*
+    Copyright (c) 2021 Andrew Petruska at Colorado School of Mines
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+    SOFTWARE.
+
+*/
+
+/**
+ * Timer_Wheel.h/c provides software timers driven by the Timer0 1 kHz compare ISR (see Timing.h).
+ *
+ * Timers are identified by a number from 0 to TIMER_WHEEL_COUNT-1 (set at compile time). Each can be one-shot or
+ * periodic with a period of up to 2^31 ms. When a timer expires it either
+ *   - sets its pending bit, polled from the main loop with Timer_Wheel_Pending(), or
+ *   - if it was started with a callback, has that callback run from the main loop by Timer_Wheel_Run()
+ *     (callbacks never run inside the ISR).
+ *
+ * The timers are kept in a hashed timing wheel of TIMER_WHEEL_SLOTS lists indexed by expiry time, so each 1 ms
+ * tick only visits the timers hashed to the current slot instead of every timer.
+ */
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TIMER_WHEEL_COUNT
+#define TIMER_WHEEL_COUNT 8     // number of timers, at most 32 (pending flags are a uint32_t bitmask)
+#endif
+
+#ifndef TIMER_WHEEL_SLOTS
+#define TIMER_WHEEL_SLOTS 16    // wheel size, a power of two
+#endif
+
+/**
+ * Timer callbacks receive the id of the timer that expired.
+ */
+typedef void (*Timer_Wheel_Callback_t)( uint8_t timer_id );
+
+/**
+ * Function Timer_Wheel_Init stops every timer and clears the pending flags. SetupTimer0 calls this.
+ */
+void Timer_Wheel_Init();
+
+/**
+ * Function Timer_Wheel_Start (re)starts a timer.
+ * @param timer_id [uint8_t] timer to start, 0 to TIMER_WHEEL_COUNT-1
+ * @param delay_ms [uint32_t] time until the first expiry (at least 1 ms)
+ * @param period_ms [uint32_t] repeat period after the first expiry, 0 for a one-shot timer
+ * @param callback [Timer_Wheel_Callback_t] function Timer_Wheel_Run calls on expiry, NULL to use the pending flag
+ */
+void Timer_Wheel_Start( uint8_t timer_id, uint32_t delay_ms, uint32_t period_ms, Timer_Wheel_Callback_t callback );
+
+/**
+ * Function Timer_Wheel_Stop stops a timer and clears its pending flag.
+ * @param timer_id [uint8_t] timer to stop
+ */
+void Timer_Wheel_Stop( uint8_t timer_id );
+
+/**
+ * Function Timer_Wheel_Pending indicates if a timer expired since the last call, and clears the flag.
+ * @param timer_id [uint8_t] timer to check
+ * @return [bool] True if the timer has expired
+ */
+bool Timer_Wheel_Pending( uint8_t timer_id );
+
+/**
+ * Function Timer_Wheel_Run calls the callbacks of all expired timers started with a callback. Call it from the
+ * main loop.
+ */
+void Timer_Wheel_Run();
+
+/**
+ * Function Timer_Wheel_Tick advances the wheel by one millisecond. It is called from the Timer0 compare ISR.
+ */
+void Timer_Wheel_Tick();
+
+#endif //_TIMER_WHEEL_H
@@ -29,6 +29,9 @@
 */
 
 #include "../c_lib/Timing.h"
+#include "../c_lib/Timer_Wheel.h"
+
+#include <util/atomic.h> // for reading the multi-byte counters without an ISR tearing them
 
 
 /** These define the internal counters that will be updated in the ISR to keep track of the time
@@ -63,13 +66,16 @@ void SetupTimer0()
     TCNT0 = 0;
     // set timer0 compare match value A (Sec. 13.6.2 & 13.8.4)
     OCR0A = 249;
+    // CTC mode (Sec. 13.7.2): the hardware clears TCNT0 on the compare match, so the ISR does not have to
+    TCCR0A = (1<<WGM01);
     // set prescaling to 1:64 (Sec. 13.8.2)
-    TCCR0B |= (1<<CS00);
-    TCCR0B |= (1<<CS01);
+    TCCR0B = (1<<CS01) | (1<<CS00);
     // enable timer0 compare match interrupt (Sec. 13.8.6)
+    TIFR0  = (1<<OCF0A);
     TIMSK0 |= (1<<OCIE0A);
 
     // initialize counters
+    Timer_Wheel_Init();
     _count_ms    = 0;
     ms_counter_1 = 0;
     ms_counter_2 = 0;
@@ -77,20 +83,76 @@ void SetupTimer0()
     ms_counter_4 = 0;
 }
 
+/**
+ * Function _timer0_snapshot reads the millisecond counter and TCNT0 as one consistent pair. Interrupts are held off
+ * so the ISR cannot change _count_ms between the bytes, and a compare match that has happened but whose ISR has not
+ * run yet (OCF0A still set) is accounted for by re-reading TCNT0 and adding the millisecond the ISR would have.
+ * @param p_ms [uint32_t*] milliseconds since SetupTimer0
+ * @param p_count [uint8_t*] Timer0 counts (4us each) into the current millisecond
+ */
+static inline void _timer0_snapshot(uint32_t* p_ms, uint8_t* p_count)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+        uint32_t ms    = _count_ms;
+        uint8_t  count = TCNT0;
+
+        if(TIFR0 & (1<<OCF0A)){
+            count = TCNT0; // this read is certainly after the wrap
+            ms++;
+        }
+
+        *p_ms    = ms;
+        *p_count = count;
+    }
+}
+
 /**
  * This function gets the current time and returns it in a Time_t structure.
  * @return
  */
 Time_t GetTime()
 {
+    uint32_t ms;
+    uint8_t  count;
+    _timer0_snapshot(&ms, &count);
+
     Time_t time = {
-                    .millisec = _count_ms,
-                    .microsec = 4 * TCNT0
+                    .millisec = ms,
+                    .microsec = 4 * (uint16_t)count
                   };
 
     return time;
 }
 
+/**
+ * Function GetMicros32 returns the time since SetupTimer0 in microseconds (4us resolution). It is monotonic and
+ * rolls over every 2^32 us (about 71.6 minutes), so compare times by their (unsigned) difference.
+ * @return [uint32_t] microseconds
+ */
+uint32_t GetMicros32()
+{
+    uint32_t ms;
+    uint8_t  count;
+    _timer0_snapshot(&ms, &count);
+
+    return ms * 1000 + 4 * (uint16_t)count;
+}
+
+/**
+ * Function GetTicks returns the number of 1 ms Timer0 ticks since SetupTimer0. It counts a pending compare match the
+ * same way GetTime and GetMicros32 do, so every clock accessor agrees on the current millisecond.
+ * @return [uint32_t] milliseconds
+ */
+uint32_t GetTicks()
+{
+    uint32_t ms;
+    uint8_t  count;
+    _timer0_snapshot(&ms, &count);
+    (void)count;
+
+    return ms;
+}
+
 float  GetTimeSec()
 {
     Time_t time = GetTime();
@@ -104,8 +166,7 @@ float  GetTimeSec()
  */
 uint32_t GetMilli()
 {
-    Time_t time = GetTime();
-    return time.millisec;
+    return GetTicks();
 }
 uint16_t GetMicro()
 {
@@ -121,15 +182,64 @@ uint16_t GetMicro()
  */
 float  SecondsSince(const Time_t* time_start_p)
 {
-    // float delta_time = 0; // initialize to zero
-    //float current_time = (float) GetMilli(); // get the current time (in millisec)
-    //delta_time = current_time - time_start_p->millisec;
-    //float current_time = GetTimeSec(); // get the current time (in sec)
-    //delta_time = current_time - (time_start_p->millisec / 1000);
-    //return delta_time;
-    float delta_time = 0; // initialize to zero
     Time_t current_time = GetTime();
-    return delta_time = ((current_time.microsec-time_start_p->microsec)/1e6 + (current_time.millisec-time_start_p->millisec))/1e3;
+
+    // Differences in integers (the unsigned millisecond difference is rollover safe), one conversion at the end
+    uint32_t delta_ms = current_time.millisec - time_start_p->millisec;
+    int16_t  delta_us = (int16_t)(current_time.microsec - time_start_p->microsec);
+
+    return delta_ms * 1e-3f + delta_us * 1e-6f;
+}
+
+/**
+ * Function TicksSince returns the whole milliseconds since time_start_p, without float math.
+ * @param time_start_p a pointer to a start time struct
+ * @return [uint32_t] milliseconds
+ */
+uint32_t TicksSince(const Time_t* time_start_p)
+{
+    Time_t current_time = GetTime();
+    uint32_t delta_ms = current_time.millisec - time_start_p->millisec;
+
+    // a partial millisecond does not count
+    if(current_time.microsec < time_start_p->microsec && delta_ms > 0) delta_ms--;
+
+    return delta_ms;
+}
+
+/**
+ * Function MicrosSince returns the microseconds since time_start_p, without float math.
+ * @param time_start_p a pointer to a start time struct
+ * @return [uint32_t] microseconds
+ */
+uint32_t MicrosSince(const Time_t* time_start_p)
+{
+    Time_t current_time = GetTime();
+
+    uint32_t delta_ms = current_time.millisec - time_start_p->millisec;
+    int16_t  delta_us = (int16_t)(current_time.microsec - time_start_p->microsec);
+
+    return delta_ms * 1000 + delta_us;
+}
+
+/**
+ * Function TimeReached indicates if GetTicks() has reached a deadline (rollover safe).
+ * @param deadline_ticks [uint32_t] deadline in milliseconds
+ * @return [bool] True once the deadline has passed
+ */
+bool TimeReached(uint32_t deadline_ticks)
+{
+    return (int32_t)(GetTicks() - deadline_ticks) >= 0;
+}
+
+/**
+ * Function MicrosReached indicates if GetMicros32() has reached a deadline (rollover safe).
+ * @param deadline_us [uint32_t] deadline in microseconds
+ * @return [bool] True once the deadline has passed
+ */
+bool MicrosReached(uint32_t deadline_us)
+{
+    return (int32_t)(GetMicros32() - deadline_us) >= 0;
 }
 
 /** This is the Interrupt Service Routine for the Timer0 Compare A feature.
@@ -138,8 +248,7 @@ float  SecondsSince(const Time_t* time_start_p)
  */
 ISR(TIMER0_COMPA_vect)
 {
-    // initialize timer0
-    TCNT0 = 0;
+    // TCNT0 is cleared by the hardware (CTC mode)
 
     // take care of upticks of both our internal and external variables.
     _count_ms ++;
@@ -148,4 +257,7 @@ ISR(TIMER0_COMPA_vect)
     ms_counter_2 ++;
     ms_counter_3 ++;
     ms_counter_4 ++;
+
+    // software timers
+    Timer_Wheel_Tick();
 }
\ No newline at end of file
@@ -35,8 +35,8 @@
  * Section: 13. 8-bit Timer/Counter0 with PWM (Page 94) in the Atmel atmega32U4 datasheet.
  *
  * This will count time in 4us increments and provide an ISR at 1kHz using the A compare.  As
- * Timer 0 has two compare capabilities, the B can be used elsewhere, but note that this class
- * will be resetting it every time it reaches 249.
+ * Timer 0 has two compare capabilities, the B can be used elsewhere, but note that Timer0 runs in
+ * CTC mode and the hardware resets it every time it reaches 249.
  *
  */
 #ifndef LAB2_TIMING_TIMING_H
@@ -46,6 +46,7 @@
 #include <avr/interrupt.h>  // for interrupt service routine use
 
 #include <ctype.h>
+#include <stdbool.h>
 
 
 /**
@@ -86,6 +87,19 @@ typedef struct { uint32_t millisec; uint16_t microsec; } Time_t;
 Time_t GetTime();
 float  GetTimeSec();
 
+/**
+ * Function GetMicros32 returns the time since SetupTimer0 in microseconds (4us resolution). It is read atomically,
+ * is monotonic, and rolls over every 2^32 us (about 71.6 minutes), so compare times by their (unsigned) difference.
+ * @return [uint32_t] microseconds
+ */
+uint32_t GetMicros32();
+
+/**
+ * Function GetTicks returns the number of 1 ms Timer0 ticks since SetupTimer0 (read atomically).
+ * @return [uint32_t] milliseconds
+ */
+uint32_t GetTicks();
+
 /**
  * This function takes a start time and calculates the time since that time, it returns it in the Time struct.
  * @param p_time_start a pointer to a start time struct
@@ -93,4 +107,23 @@ float  GetTimeSec();
  */
 float  SecondsSince(const Time_t* time_start_p );
 
+/**
+ * Integer elapsed-time functions. These avoid float math (and so are cheap enough for control loops); convert to
+ * seconds only when a value is actually sent to the host. Differences are taken unsigned, so they are correct
+ * across counter rollover as long as the interval itself is shorter than the rollover period.
+ *
+ * TicksSince returns the whole milliseconds since time_start_p.
+ * MicrosSince returns the microseconds (4us resolution) since time_start_p; intervals must be under ~71 minutes.
+ */
+uint32_t TicksSince(const Time_t* time_start_p );
+uint32_t MicrosSince(const Time_t* time_start_p );
+
+/**
+ * Deadline checks. TimeReached is true once GetTicks() has reached deadline_ticks, MicrosReached once
+ * GetMicros32() has reached deadline_us. Both compare the signed difference, so they work across rollover for
+ * deadlines less than half the rollover period away. Advance a periodic deadline by adding the period to it.
+ */
+bool TimeReached(uint32_t deadline_ticks );
+bool MicrosReached(uint32_t deadline_us );
+
 #endif //LAB2_TIMING_TIMING_H